@@ -0,0 +1,48 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-26
+ * @copyleft Apache 2.0
+ */
+#include "arena.h"
+
+Arena::~Arena()
+{
+    Reset();
+}
+
+void Arena::Reset()
+{
+    while (chunks_)
+    {
+        Chunk *next = chunks_->next;
+        BlockPool::Instance()->Free(reinterpret_cast<char *>(chunks_), chunks_->cap);
+        chunks_ = next;
+    }
+    cur_ = nullptr;
+    left_ = 0;
+    used_ = 0;
+}
+
+void *Arena::do_allocate(size_t bytes, size_t align)
+{
+    assert(align > 0 && (align & (align - 1)) == 0);
+    size_t pad = (align - reinterpret_cast<uintptr_t>(cur_) % align) % align;
+    if (cur_ == nullptr || pad + bytes > left_)
+    {
+        /* 当前块放不下: 再借一块, 过大的请求单独占一块 */
+        size_t cap = std::max(CHUNK_SIZE, sizeof(Chunk) + bytes + align);
+        char *data = BlockPool::Instance()->Alloc(cap);
+        Chunk *chunk = reinterpret_cast<Chunk *>(data);
+        chunk->next = chunks_;
+        chunk->cap = cap;
+        chunks_ = chunk;
+        cur_ = data + sizeof(Chunk);
+        left_ = cap - sizeof(Chunk);
+        pad = (align - reinterpret_cast<uintptr_t>(cur_) % align) % align;
+    }
+    void *ret = cur_ + pad;
+    cur_ += pad + bytes;
+    left_ -= pad + bytes;
+    used_ += bytes;
+    return ret;
+}
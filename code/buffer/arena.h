@@ -0,0 +1,56 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-26
+ * @copyleft Apache 2.0
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <memory_resource>
+#include <cstddef>
+#include <stdint.h>
+#include <algorithm>
+#include <assert.h>
+#include "blockpool.h"
+
+/* 单调内存资源: 分配只移动指针, 释放为空操作, Reset() 一次性把全部内存块归还 BlockPool
+   供一次请求内的 std::pmr 容器与临时字符串使用; Reset() 前必须先销毁或重建其上的对象 */
+class Arena : public std::pmr::memory_resource
+{
+public:
+    static constexpr size_t CHUNK_SIZE = 4096;
+
+    Arena() : chunks_(nullptr), cur_(nullptr), left_(0), used_(0) {}
+    ~Arena();
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void Reset();
+
+    /* 上次 Reset() 以来分配出去的字节数 */
+    size_t Used() const { return used_; }
+
+private:
+    void *do_allocate(size_t bytes, size_t align) override;
+    void do_deallocate(void *, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    /* 块首部, 块之间串成单链表 */
+    struct Chunk
+    {
+        Chunk *next;
+        size_t cap;
+    };
+
+    Chunk *chunks_;
+    char *cur_;
+    size_t left_;
+    size_t used_;
+};
+
+#endif // ARENA_H
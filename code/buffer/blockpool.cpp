@@ -0,0 +1,117 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-26
+ * @copyleft Apache 2.0
+ */
+#include "blockpool.h"
+
+/* 线程私有的空闲链表, 空闲块的首部存放下一块的指针 */
+struct BlockCache
+{
+    char *heads[BlockPool::CLASS_NUM] = {};
+    size_t bytes[BlockPool::CLASS_NUM] = {};
+
+    ~BlockCache();
+};
+
+/* 线程退出时缓存先于部分静态对象析构, 此后的分配和归还直接走系统 */
+static thread_local bool cacheDead = false;
+
+static BlockCache *LocalCache()
+{
+    if (cacheDead)
+    {
+        return nullptr;
+    }
+    static thread_local BlockCache cache;
+    return &cache;
+}
+
+BlockCache::~BlockCache()
+{
+    cacheDead = true;
+    BlockPool *pool = BlockPool::Instance();
+    for (int i = 0; i < BlockPool::CLASS_NUM; i++)
+    {
+        while (heads[i])
+        {
+            char *block = heads[i];
+            heads[i] = *reinterpret_cast<char **>(block);
+            delete[] block;
+        }
+        pool->cachedBytes_.fetch_sub(bytes[i], std::memory_order_relaxed);
+        bytes[i] = 0;
+    }
+}
+
+BlockPool *BlockPool::Instance()
+{
+    static BlockPool pool;
+    return &pool;
+}
+
+int BlockPool::ClassOf_(size_t cap)
+{
+    int idx = 0;
+    size_t size = MIN_CLASS;
+    while (size < cap)
+    {
+        size <<= 2;
+        idx++;
+    }
+    return idx;
+}
+
+char *BlockPool::Alloc(size_t &cap)
+{
+    assert(cap > 0);
+    if (cap > MAX_CLASS)
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        inUseBytes_.fetch_add(cap, std::memory_order_relaxed);
+        return new char[cap];
+    }
+    int idx = ClassOf_(cap);
+    cap = MIN_CLASS << (2 * idx);
+    inUseBytes_.fetch_add(cap, std::memory_order_relaxed);
+    BlockCache *cache = LocalCache();
+    if (cache && cache->heads[idx])
+    {
+        char *block = cache->heads[idx];
+        cache->heads[idx] = *reinterpret_cast<char **>(block);
+        cache->bytes[idx] -= cap;
+        cachedBytes_.fetch_sub(cap, std::memory_order_relaxed);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return block;
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return new char[cap];
+}
+
+void BlockPool::Free(char *data, size_t cap)
+{
+    assert(data);
+    inUseBytes_.fetch_sub(cap, std::memory_order_relaxed);
+    BlockCache *cache = cap <= MAX_CLASS ? LocalCache() : nullptr;
+    int idx = ClassOf_(cap);
+    if (cache == nullptr || cache->bytes[idx] + cap > MAX_CACHED_PER_CLASS)
+    {
+        delete[] data;
+        return;
+    }
+    assert(cap == MIN_CLASS << (2 * idx));
+    *reinterpret_cast<char **>(data) = cache->heads[idx];
+    cache->heads[idx] = data;
+    cache->bytes[idx] += cap;
+    cachedBytes_.fetch_add(cap, std::memory_order_relaxed);
+}
+
+BlockPool::Stats BlockPool::GetStats() const
+{
+    Stats stats;
+    stats.inUseBytes = inUseBytes_.load(std::memory_order_relaxed);
+    stats.cachedBytes = cachedBytes_.load(std::memory_order_relaxed);
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.misses = misses_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,55 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-26
+ * @copyleft Apache 2.0
+ */
+
+#ifndef BLOCKPOOL_H
+#define BLOCKPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <assert.h>
+
+/* 缓冲区块的分级内存池: 块大小按 1K/4K/16K/64K 分级, 每个线程为每一级缓存若干空闲块
+   分配和归还只操作本线程的空闲链表, 无锁; 块可在一个线程分配、在另一个线程归还
+   每级缓存有字节上限, 超出部分以及超过最大级别的块直接交还系统 */
+class BlockPool
+{
+public:
+    static const int CLASS_NUM = 4;
+    static const size_t MIN_CLASS = 1024;
+    static const size_t MAX_CLASS = MIN_CLASS << (2 * (CLASS_NUM - 1));
+    static const size_t MAX_CACHED_PER_CLASS = 256 * 1024; /* 每个线程每一级最多缓存的字节数 */
+
+    struct Stats
+    {
+        size_t inUseBytes;  /* 缓冲区正在持有的块 */
+        size_t cachedBytes; /* 各线程空闲链表中的块 */
+        size_t hits;        /* 由空闲链表满足的分配 */
+        size_t misses;      /* 向系统申请的分配 */
+    };
+
+    static BlockPool *Instance();
+
+    /* cap 向上取整到所属级别的大小 */
+    char *Alloc(size_t &cap);
+    void Free(char *data, size_t cap);
+
+    Stats GetStats() const;
+
+private:
+    BlockPool() = default;
+
+    static int ClassOf_(size_t cap);
+
+    /* 全部成员可平凡析构, 静态析构阶段仍可安全归还 */
+    std::atomic<size_t> inUseBytes_{0};
+    std::atomic<size_t> cachedBytes_{0};
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+
+    friend struct BlockCache;
+};
+
+#endif // BLOCKPOOL_H
@@ -5,31 +5,134 @@
  */
 #include "buffer.h"
 
-Buffer::Buffer(int initBuffSize) : buffer_(initBuffSize), readPos_(0), writePos_(0) {}
+Buffer::Buffer(int initBuffSize) : blockSize_(initBuffSize), readable_(0)
+{
+    assert(initBuffSize > 0);
+}
+
+Buffer::~Buffer()
+{
+    for (auto &block : blocks_)
+    {
+        FreeBlock_(block.data, block.cap);
+    }
+}
+
+char *Buffer::AllocBlock_(size_t &cap)
+{
+    /* 不做清零, 块内只有 [rd, wr) 有意义 */
+    return BlockPool::Instance()->Alloc(cap);
+}
+
+void Buffer::FreeBlock_(char *data, size_t cap)
+{
+    BlockPool::Instance()->Free(data, cap);
+}
+
+void Buffer::PushBlock_(size_t cap) const
+{
+    char *data = AllocBlock_(cap);
+    blocks_.push_back({data, cap, 0, 0});
+}
+
+void Buffer::ReleaseAll_()
+{
+    for (auto &block : blocks_)
+    {
+        FreeBlock_(block.data, block.cap);
+    }
+    blocks_.clear();
+}
+
+void Buffer::PopFront_() const
+{
+    assert(!blocks_.empty());
+    FreeBlock_(blocks_.front().data, blocks_.front().cap);
+    blocks_.erase(blocks_.begin());
+}
+
+void Buffer::Coalesce_() const
+{
+    /* 丢弃首尾的空块; 仍跨多块时拷贝到一个新块, 使可读数据连续且位于尾块 */
+    while (blocks_.size() > 1 && blocks_.front().rd == blocks_.front().wr)
+    {
+        PopFront_();
+    }
+    while (blocks_.size() > 1 && blocks_.back().rd == blocks_.back().wr)
+    {
+        FreeBlock_(blocks_.back().data, blocks_.back().cap);
+        blocks_.pop_back();
+    }
+    if (blocks_.size() <= 1)
+    {
+        return;
+    }
+    size_t cap = std::max(readable_, blockSize_);
+    char *data = AllocBlock_(cap);
+    Block merged = {data, cap, 0, 0};
+    for (auto &block : blocks_)
+    {
+        memcpy(merged.data + merged.wr, block.data + block.rd, block.wr - block.rd);
+        merged.wr += block.wr - block.rd;
+        FreeBlock_(block.data, block.cap);
+    }
+    blocks_.clear();
+    blocks_.push_back(merged);
+}
 
 size_t Buffer::ReadableBytes() const
 {
-    return writePos_ - readPos_;
+    return readable_;
 }
+
 size_t Buffer::WritableBytes() const
 {
-    return buffer_.size() - writePos_;
+    if (blocks_.empty())
+    {
+        return 0;
+    }
+    return blocks_.back().cap - blocks_.back().wr;
 }
 
 size_t Buffer::PrependableBytes() const
 {
-    return readPos_;
+    if (blocks_.empty())
+    {
+        return 0;
+    }
+    return blocks_.front().rd;
 }
 
 const char *Buffer::Peek() const
 {
-    return BeginPtr_() + readPos_;
+    if (blocks_.empty())
+    {
+        return "";
+    }
+    Coalesce_();
+    return blocks_.front().data + blocks_.front().rd;
 }
 
 void Buffer::Retrieve(size_t len)
 {
     assert(len <= ReadableBytes());
-    readPos_ += len;
+    readable_ -= len;
+    while (len > 0)
+    {
+        Block &block = blocks_.front();
+        size_t n = std::min(len, block.wr - block.rd);
+        block.rd += n;
+        len -= n;
+        if (block.rd == block.wr && blocks_.size() > 1)
+        {
+            PopFront_();
+        }
+    }
+    if (readable_ == 0)
+    {
+        /* 数据已取完: 块全部归还内存池 */
+        ReleaseAll_();
+    }
 }
 
 void Buffer::RetrieveUntil(const char *end)
@@ -40,34 +143,50 @@ void Buffer::RetrieveUntil(const char *end)
 
 void Buffer::RetrieveAll()
 {
-    bzero(&buffer_[0], buffer_.size());
-    readPos_ = 0;
-    writePos_ = 0;
+    ReleaseAll_();
+    readable_ = 0;
 }
 
 std::string Buffer::RetrieveAllToStr()
 {
-    std::string str(Peek(), ReadableBytes());
+    std::string str;
+    str.reserve(readable_);
+    for (auto &block : blocks_)
+    {
+        str.append(block.data + block.rd, block.wr - block.rd);
+    }
     RetrieveAll();
     return str;
 }
 
 const char *Buffer::BeginWriteConst() const
 {
-    return BeginPtr_() + writePos_;
+    /* 作为可读区间的尾端使用, 与 Peek() 一样先合并, 两者求值先后不影响结果 */
+    if (blocks_.empty())
+    {
+        return Peek();
+    }
+    Coalesce_();
+    return blocks_.back().data + blocks_.back().wr;
 }
 
 char *Buffer::BeginWrite()
 {
-    return BeginPtr_() + writePos_;
+    if (blocks_.empty())
+    {
+        PushBlock_(blockSize_);
+    }
+    return blocks_.back().data + blocks_.back().wr;
 }
 
 void Buffer::HasWritten(size_t len)
 {
-    writePos_ += len;
+    assert(len <= WritableBytes());
+    blocks_.back().wr += len;
+    readable_ += len;
 }
 
-void Buffer::Append(const std::string &str)
+void Buffer::Append(std::string_view str)
 {
     Append(str.data(), str.length());
 }
@@ -81,88 +200,129 @@ void Buffer::Append(const void *data, size_t len)
 void Buffer::Append(const char *str, size_t len)
 {
     assert(str);
-    EnsureWriteable(len);
-    std::copy(str, str + len, BeginWrite());
-    HasWritten(len);
+    /* 先填满尾块剩余空间, 不足部分链接到新块 */
+    size_t n = std::min(len, WritableBytes());
+    if (n > 0)
+    {
+        memcpy(BeginWrite(), str, n);
+        HasWritten(n);
+    }
+    if (len > n)
+    {
+        PushBlock_(std::max(len - n, blockSize_));
+        memcpy(BeginWrite(), str + n, len - n);
+        HasWritten(len - n);
+    }
 }
 
 void Buffer::Append(const Buffer &buff)
 {
-    Append(buff.Peek(), buff.ReadableBytes());
+    for (auto &block : buff.blocks_)
+    {
+        Append(block.data + block.rd, block.wr - block.rd);
+    }
 }
 
 void Buffer::EnsureWriteable(size_t len)
 {
     if (WritableBytes() < len)
     {
-        MakeSpace_(len);
+        if (!blocks_.empty() && readable_ == 0)
+        {
+            /* 空缓冲区直接换一个足够大的块 */
+            PopFront_();
+        }
+        PushBlock_(std::max(len, blockSize_));
     }
     assert(WritableBytes() >= len);
 }
 
+int Buffer::GetIov(struct iovec *iov, int maxCnt) const
+{
+    int cnt = 0;
+    for (size_t i = 0; i < blocks_.size() && cnt < maxCnt; i++)
+    {
+        const Block &block = blocks_[i];
+        if (block.rd == block.wr)
+        {
+            continue;
+        }
+        iov[cnt].iov_base = block.data + block.rd;
+        iov[cnt].iov_len = block.wr - block.rd;
+        cnt++;
+    }
+    return cnt;
+}
+
 ssize_t Buffer::ReadFd(int fd, int *saveErrno)
 {
-    char buff[65535];
+    /* 分散读: 先填尾块剩余空间, 再读入从内存池借来的最大级别块, 保证数据全部读完 */
+    size_t extraCap = BlockPool::MAX_CLASS;
+    char *extra = AllocBlock_(extraCap);
     struct iovec iov[2];
+    int iovCnt = 0;
     const size_t writable = WritableBytes();
-    /* 分散读， 保证数据全部读完 */
-    iov[0].iov_base = BeginPtr_() + writePos_;
-    iov[0].iov_len = writable;
-    iov[1].iov_base = buff;
-    iov[1].iov_len = sizeof(buff);
+    if (writable > 0)
+    {
+        iov[iovCnt].iov_base = BeginWrite();
+        iov[iovCnt].iov_len = writable;
+        iovCnt++;
+    }
+    iov[iovCnt].iov_base = extra;
+    iov[iovCnt].iov_len = extraCap;
+    iovCnt++;
 
-    const ssize_t len = readv(fd, iov, 2);
+    const ssize_t len = readv(fd, iov, iovCnt);
     if (len < 0)
     {
         *saveErrno = errno;
+        FreeBlock_(extra, extraCap);
     }
     else if (static_cast<size_t>(len) <= writable)
     {
-        writePos_ += len;
+        if (len > 0)
+        {
+            HasWritten(len);
+        }
+        FreeBlock_(extra, extraCap);
     }
     else
     {
-        writePos_ = buffer_.size();
-        Append(buff, len - writable);
+        if (writable > 0)
+        {
+            HasWritten(writable);
+        }
+        size_t rest = len - writable;
+        if (rest >= extraCap / 2)
+        {
+            /* 读入量大时直接把借来的块链到尾部, 免去一次拷贝 */
+            blocks_.push_back({extra, extraCap, 0, rest});
+            readable_ += rest;
+        }
+        else
+        {
+            /* 读入量小时拷贝到合适大小的块, 大块立即归还 */
+            Append(extra, rest);
+            FreeBlock_(extra, extraCap);
+        }
+    }
+    if (readable_ == 0)
+    {
+        ReleaseAll_();
     }
     return len;
 }
 
 ssize_t Buffer::WriteFd(int fd, int *saveErrno)
 {
-    size_t readSize = ReadableBytes();
-    ssize_t len = write(fd, Peek(), readSize);
+    struct iovec iov[16];
+    int cnt = GetIov(iov, 16);
+    ssize_t len = writev(fd, iov, cnt);
     if (len < 0)
     {
         *saveErrno = errno;
         return len;
     }
-    readPos_ += len;
+    Retrieve(len);
     return len;
 }
-
-char *Buffer::BeginPtr_()
-{
-    return &*buffer_.begin();
-}
-
-const char *Buffer::BeginPtr_() const
-{
-    return &*buffer_.begin();
-}
-
-void Buffer::MakeSpace_(size_t len)
-{
-    if (WritableBytes() + PrependableBytes() < len)
-    {
-        buffer_.resize(writePos_ + len + 1);
-    }
-    else
-    {
-        size_t readable = ReadableBytes();
-        std::copy(BeginPtr_() + readPos_, BeginPtr_() + writePos_, BeginPtr_());
-        readPos_ = 0;
-        writePos_ = readPos_ + readable;
-        assert(readable == ReadableBytes());
-    }
-}
\ No newline at end of file
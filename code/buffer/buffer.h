@@ -11,13 +11,22 @@
 #include <unistd.h>  // write
 #include <sys/uio.h> //readv
 #include <vector>    //readv
-#include <atomic>
+#include <algorithm>
+#include <string_view>
 #include <assert.h>
+#include "blockpool.h"
+
+/* 分段缓冲区: 由固定大小的块串成, 追加时链接新块而不搬移已有数据
+   Peek()/BeginWrite() 保持原有的连续内存接口: 可读数据跨块时 Peek() 才合并为一块
+   只有一个持有者, 读写位置为普通整数; 块向 BlockPool 借用, 可读数据取完即全部归还 */
 class Buffer
 {
 public:
     Buffer(int initBuffSize = 1024);
-    ~Buffer() = default;
+    ~Buffer();
+
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
 
     size_t WritableBytes() const;
     size_t ReadableBytes() const;
@@ -36,22 +45,39 @@ public:
     const char *BeginWriteConst() const;
     char *BeginWrite();
 
-    void Append(const std::string &str);
+    void Append(std::string_view str);
     void Append(const char *str, size_t len);
     void Append(const void *data, size_t len);
     void Append(const Buffer &buff);
 
+    /* 可读数据的iovec视图, 每块一项, 不合并; 返回填写的项数 */
+    int GetIov(struct iovec *iov, int maxCnt) const;
+
     ssize_t ReadFd(int fd, int *Errno);
     ssize_t WriteFd(int fd, int *Errno);
 
 private:
-    char *BeginPtr_();
-    const char *BeginPtr_() const;
-    void MakeSpace_(size_t len);
+    struct Block
+    {
+        char *data;
+        size_t cap;
+        size_t rd; /* 块内读位置 */
+        size_t wr; /* 块内写位置 */
+    };
+
+    static char *AllocBlock_(size_t &cap);
+    static void FreeBlock_(char *data, size_t cap);
+
+    void PushBlock_(size_t cap) const;
+    void PopFront_() const;
+    void Coalesce_() const;
+    void ReleaseAll_();
+
+    size_t blockSize_;
+    size_t readable_;
 
-    std::vector<char> buffer_;
-    std::atomic<std::size_t> readPos_;
-    std::atomic<std::size_t> writePos_;
+    /* Peek() 合并块时会调整块链, 不改变可读内容 */
+    mutable std::vector<Block> blocks_;
 };
 
-#endif // BUFFER_H
\ No newline at end of file
+#endif // BUFFER_H
@@ -0,0 +1,165 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-25
+ * @copyleft Apache 2.0
+ */
+#include "chunkeddecoder.h"
+
+#include <algorithm>
+#include "../log/log.h"
+
+namespace
+{
+    int HexValue(char ch)
+    {
+        if (ch >= '0' && ch <= '9')
+            return ch - '0';
+        if (ch >= 'a' && ch <= 'f')
+            return ch - 'a' + 10;
+        if (ch >= 'A' && ch <= 'F')
+            return ch - 'A' + 10;
+        return -1;
+    }
+
+    bool IsCtl(char ch)
+    {
+        unsigned char c = static_cast<unsigned char>(ch);
+        return (c < ' ' && c != '\t') || c == 0x7f;
+    }
+}
+
+void ChunkedDecoder::Reset()
+{
+    state_ = SIZE;
+    error_ = NEED_MORE;
+    left_ = 0;
+    digits_ = 0;
+    lineSize_ = 0;
+}
+
+ChunkedDecoder::STATUS ChunkedDecoder::Decode(const char *data, size_t len, size_t &used, RequestBody &body, size_t maxSize)
+{
+    /* chunk = chunk-size [ chunk-ext ] CRLF chunk-data CRLF, 以长度为0的块和尾部字段结束 */
+    used = 0;
+    if (error_ != NEED_MORE)
+    {
+        return error_;
+    }
+    const char *p = data, *end = data + len;
+    while (p < end && state_ != END)
+    {
+        if (state_ == DATA)
+        {
+            size_t n = std::min(left_, static_cast<size_t>(end - p));
+            if (!body.Append(p, n))
+            {
+                return error_ = WRITE_ERROR;
+            }
+            p += n;
+            left_ -= n;
+            if (left_ == 0)
+            {
+                state_ = DATA_CR;
+            }
+            continue;
+        }
+        char ch = *p++;
+        switch (state_)
+        {
+        case SIZE:
+        {
+            int v = HexValue(ch);
+            if (v >= 0 && digits_ < MAX_SIZE_DIGITS)
+            {
+                left_ = left_ * 16 + v;
+                digits_++;
+            }
+            else if (digits_ > 0 && (ch == ';' || ch == ' ' || ch == '\t'))
+            {
+                state_ = SIZE_EXT;
+            }
+            else if (digits_ > 0 && ch == '\r')
+            {
+                state_ = SIZE_LF;
+            }
+            else
+            {
+                LOG_ERROR("Invalid chunk size");
+                return error_ = BAD;
+            }
+            break;
+        }
+        case SIZE_EXT:
+        case TRAILER_LINE:
+            if (ch == '\r')
+            {
+                state_ = state_ == SIZE_EXT ? SIZE_LF : TRAILER_LF;
+            }
+            else if (IsCtl(ch) || ++lineSize_ > MAX_LINE_SIZE)
+            {
+                LOG_ERROR("Invalid chunk extension or trailer");
+                return error_ = BAD;
+            }
+            break;
+        case SIZE_LF:
+            if (ch != '\n')
+            {
+                return error_ = BAD;
+            }
+            if (left_ == 0)
+            {
+                state_ = TRAILER;
+            }
+            else if (left_ > maxSize || body.Size() + left_ > maxSize)
+            {
+                LOG_WARN("Chunked request body too large");
+                return error_ = TOO_LARGE;
+            }
+            else
+            {
+                state_ = DATA;
+            }
+            break;
+        case DATA_CR:
+            if (ch != '\r')
+            {
+                return error_ = BAD;
+            }
+            state_ = DATA_LF;
+            break;
+        case DATA_LF:
+            if (ch != '\n')
+            {
+                return error_ = BAD;
+            }
+            state_ = SIZE;
+            digits_ = 0;
+            break;
+        case TRAILER:
+            state_ = ch == '\r' ? LAST_LF : TRAILER_LINE;
+            if (state_ == TRAILER_LINE && (IsCtl(ch) || ++lineSize_ > MAX_LINE_SIZE))
+            {
+                return error_ = BAD;
+            }
+            break;
+        case TRAILER_LF:
+            if (ch != '\n')
+            {
+                return error_ = BAD;
+            }
+            state_ = TRAILER;
+            break;
+        case LAST_LF:
+            if (ch != '\n')
+            {
+                return error_ = BAD;
+            }
+            state_ = END;
+            break;
+        default:
+            break;
+        }
+    }
+    used = p - data;
+    return state_ == END ? DONE : NEED_MORE;
+}
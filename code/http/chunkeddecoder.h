@@ -0,0 +1,60 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-25
+ * @copyleft Apache 2.0
+ */
+#ifndef CHUNKED_DECODER_H
+#define CHUNKED_DECODER_H
+
+#include <cstddef>
+#include "requestbody.h"
+
+/* Transfer-Encoding: chunked 请求体的增量解码器
+   输入可在任意字节处断开, 状态跨调用保留; 数据段整段追加到 RequestBody, 块扩展与尾部字段校验后丢弃 */
+class ChunkedDecoder
+{
+public:
+    enum STATUS
+    {
+        NEED_MORE = 0,
+        DONE,
+        BAD,
+        TOO_LARGE,
+        WRITE_ERROR,
+    };
+
+    ChunkedDecoder() { Reset(); }
+
+    void Reset();
+
+    /* 解码 [data, data + len), used 为本次用掉的字节数; 返回 DONE 时其后的数据属于下一个请求
+       出错后状态保持不变, 再次调用返回同样的结果 */
+    STATUS Decode(const char *data, size_t len, size_t &used, RequestBody &body, size_t maxSize);
+
+private:
+    enum STATE
+    {
+        SIZE,         /* 块长度的十六进制数字 */
+        SIZE_EXT,     /* 块扩展, 直到CR */
+        SIZE_LF,
+        DATA,
+        DATA_CR,
+        DATA_LF,
+        TRAILER,      /* 尾部字段的行首, 空行结束 */
+        TRAILER_LINE,
+        TRAILER_LF,
+        LAST_LF,
+        END,
+    };
+
+    static const int MAX_SIZE_DIGITS = 15;      /* 块长度的十六进制位数上限, 防止溢出 */
+    static const size_t MAX_LINE_SIZE = 8192;   /* 块扩展与尾部字段的总长度上限 */
+
+    STATE state_;
+    STATUS error_; /* 出错后固定返回的结果 */
+    size_t left_;  /* 当前块长度, 或数据段剩余字节数 */
+    int digits_;
+    size_t lineSize_;
+};
+
+#endif // CHUNKED_DECODER_H
@@ -0,0 +1,146 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-25
+ * @copyleft Apache 2.0
+ */
+#include "headertable.h"
+
+using std::string_view;
+
+namespace
+{
+    /* 小写的标准名, 下标即 HEADER_ID */
+    constexpr string_view KNOWN_NAMES[HeaderTable::KNOWN_NUM] = {
+        "connection", "content-length", "content-type", "host",
+        "if-none-match", "range", "accept-encoding", "transfer-encoding"};
+
+    /* 以上名字长度互不相同且低4位不冲突, 取长度低4位即为完美哈希, 只需再比较一次名字 */
+    constexpr size_t SLOT_NUM = 16;
+
+    constexpr size_t Hash(string_view name)
+    {
+        return name.size() & (SLOT_NUM - 1);
+    }
+
+    struct SlotTable
+    {
+        signed char slot[SLOT_NUM];
+        bool perfect;
+
+        constexpr SlotTable() : slot(), perfect(true)
+        {
+            for (size_t i = 0; i < SLOT_NUM; i++)
+            {
+                slot[i] = -1;
+            }
+            for (int id = 0; id < HeaderTable::KNOWN_NUM; id++)
+            {
+                size_t h = Hash(KNOWN_NAMES[id]);
+                perfect = perfect && slot[h] < 0;
+                slot[h] = static_cast<signed char>(id);
+            }
+        }
+    };
+
+    constexpr SlotTable SLOTS;
+    /* 新增常用头部时若与已有名字冲突, 需调整 Hash() */
+    static_assert(SLOTS.perfect, "known header names collide in the slot table");
+}
+
+HeaderTable::HeaderTable(std::pmr::memory_resource *arena)
+    : inlineCnt_(0), extra_(arena), arena_(arena)
+{
+}
+
+void HeaderTable::Clear()
+{
+    for (string_view &v : known_)
+    {
+        v = string_view();
+    }
+    inlineCnt_ = 0;
+    extra_ = std::pmr::vector<Field>(arena_);
+}
+
+HeaderTable::HEADER_ID HeaderTable::Lookup(string_view name)
+{
+    int id = SLOTS.slot[Hash(name)];
+    if (id >= 0 && EqualsIgnoreCase_(name, KNOWN_NAMES[id]))
+    {
+        return static_cast<HEADER_ID>(id);
+    }
+    return UNKNOWN;
+}
+
+bool HeaderTable::Add(string_view name, string_view rawValue)
+{
+    HEADER_ID id = Lookup(name);
+    if (id != UNKNOWN)
+    {
+        /* 前后端对重复头部取值不一致即可走私请求(RFC 9112 6.3) */
+        if (known_[id].data() &&
+            (id == TRANSFER_ENCODING || id == HOST || (id == CONTENT_LENGTH && Trim_(known_[id]) != Trim_(rawValue))))
+        {
+            return false;
+        }
+        known_[id] = rawValue;
+    }
+    else if (inlineCnt_ < INLINE_NUM)
+    {
+        inline_[inlineCnt_++] = Field{name, rawValue};
+    }
+    else
+    {
+        extra_.push_back(Field{name, rawValue});
+    }
+    return true;
+}
+
+string_view HeaderTable::Get(string_view name) const
+{
+    HEADER_ID id = Lookup(name);
+    if (id != UNKNOWN)
+    {
+        return Get(id);
+    }
+    /* 与常用头部一致, 同名时取最后一个 */
+    for (size_t i = extra_.size(); i > 0; i--)
+    {
+        if (EqualsIgnoreCase_(extra_[i - 1].name, name))
+        {
+            return Trim_(extra_[i - 1].value);
+        }
+    }
+    for (size_t i = inlineCnt_; i > 0; i--)
+    {
+        if (EqualsIgnoreCase_(inline_[i - 1].name, name))
+        {
+            return Trim_(inline_[i - 1].value);
+        }
+    }
+    return string_view();
+}
+
+size_t HeaderTable::Size() const
+{
+    size_t n = inlineCnt_ + extra_.size();
+    for (const string_view &v : known_)
+    {
+        n += v.data() != nullptr;
+    }
+    return n;
+}
+
+string_view HeaderTable::Trim_(string_view v)
+{
+    size_t l = 0, r = v.size();
+    while (l < r && (v[l] == ' ' || v[l] == '\t'))
+    {
+        l++;
+    }
+    while (r > l && (v[r - 1] == ' ' || v[r - 1] == '\t'))
+    {
+        r--;
+    }
+    return v.data() ? string_view(v.data() + l, r - l) : v;
+}
@@ -0,0 +1,94 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-25
+ * @copyleft Apache 2.0
+ */
+#ifndef HEADER_TABLE_H
+#define HEADER_TABLE_H
+
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+#include <cstddef>
+#include <strings.h> // strncasecmp
+
+/* 请求头部表: 名与值都是指向读缓冲区的视图, 不拷贝
+   常用头部经编译期完美哈希落到固定槽位, O(1) 存取; 其余头部顺序存放, 少量时不分配内存
+   值按原样保存(含首尾空白), 读取时才去除空白, 数值等解析由调用方按需进行 */
+class HeaderTable
+{
+public:
+    enum HEADER_ID
+    {
+        CONNECTION = 0,
+        CONTENT_LENGTH,
+        CONTENT_TYPE,
+        HOST,
+        IF_NONE_MATCH,
+        RANGE,
+        ACCEPT_ENCODING,
+        TRANSFER_ENCODING,
+        KNOWN_NUM,
+        UNKNOWN = KNOWN_NUM,
+    };
+
+    explicit HeaderTable(std::pmr::memory_resource *arena = std::pmr::get_default_resource());
+
+    /* 以空对象替换溢出表, 确保不再引用 arena 中的内存 */
+    void Clear();
+
+    /* 其余头部全部保留; 同名常用头部后者覆盖前者, 但决定请求定界或目标的头部不得重复:
+       Content-Length 重复且值不同、Transfer-Encoding 或 Host 重复时不覆盖并返回false, 由调用方拒绝请求 */
+    bool Add(std::string_view name, std::string_view rawValue);
+
+    /* 不存在时返回 data() 为 nullptr 的空视图, 存在但值为空时 data() 非空 */
+    std::string_view Get(HEADER_ID id) const { return Trim_(known_[id]); }
+    std::string_view Get(std::string_view name) const;
+
+    size_t Size() const;
+
+    /* 读缓冲区整理后逐个平移视图 */
+    template <class F>
+    void Remap(F &&move)
+    {
+        for (std::string_view &v : known_)
+        {
+            v = move(v);
+        }
+        for (size_t i = 0; i < inlineCnt_; i++)
+        {
+            inline_[i].name = move(inline_[i].name);
+            inline_[i].value = move(inline_[i].value);
+        }
+        for (Field &f : extra_)
+        {
+            f.name = move(f.name);
+            f.value = move(f.value);
+        }
+    }
+
+    /* 常用头部名(大小写不敏感)对应的槽位, 其余返回 UNKNOWN */
+    static HEADER_ID Lookup(std::string_view name);
+
+private:
+    struct Field
+    {
+        std::string_view name, value;
+    };
+
+    static const size_t INLINE_NUM = 4;
+
+    static bool EqualsIgnoreCase_(std::string_view a, std::string_view b)
+    {
+        return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+    }
+    static std::string_view Trim_(std::string_view v);
+
+    std::string_view known_[KNOWN_NUM];
+    Field inline_[INLINE_NUM];
+    size_t inlineCnt_;
+    std::pmr::vector<Field> extra_;
+    std::pmr::memory_resource *arena_;
+};
+
+#endif // HEADER_TABLE_H
@@ -9,12 +9,21 @@ using namespace std;
 const char *HttpConn::srcDir;
 std::atomic<int> HttpConn::userCount;
 bool HttpConn::isET;
+int HttpConn::keepAliveMax = 100;
+int HttpConn::keepAliveTimeout = 0;
 
-HttpConn::HttpConn()
+HttpConn::HttpConn() : request_(&arena_), response_(&arena_)
 {
     fd_ = -1;
     addr_ = {0};
     isClose_ = true;
+    isBadRequest_ = false;
+    errorCode_ = 400;
+    isKeepAlive_ = false;
+    requestCount_ = 0;
+    queueHead_ = queueCnt_ = 0;
+    toWrite_ = 0;
+    iovCnt_ = 0;
 };
 
 HttpConn::~HttpConn()
@@ -30,6 +39,11 @@ void HttpConn::init(int fd, const sockaddr_in &addr)
     fd_ = fd;
     writeBuff_.RetrieveAll();
     readBuff_.RetrieveAll();
+    request_.Init();
+    arena_.Reset();
+    ClearQueue_();
+    isKeepAlive_ = false;
+    requestCount_ = 0;
     isClose_ = false;
     LOG_INFO("Client[%d](%s:%d) in, userCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
 }
@@ -37,12 +51,15 @@ void HttpConn::init(int fd, const sockaddr_in &addr)
 void HttpConn::Close()
 {
     response_.UnmapFile();
+    ClearQueue_();
+    request_.Init(); /* 关闭可能持有的请求体临时文件 */
     if (isClose_ == false)
     {
         isClose_ = true;
         userCount--;
-        close(fd_);
+        /* close 之后 fd 可能立刻被其他Reactor接受的连接复用并重新 init 本槽位, 之后不能再读成员 */
         LOG_INFO("Client[%d](%s:%d) quit, UserCount:%d", fd_, GetIP(), GetPort(), (int)userCount);
+        close(fd_);
     }
 }
 
@@ -76,6 +93,14 @@ ssize_t HttpConn::read(int *saveErrno)
         {
             break;
         }
+        /* ET模式一直读到EAGAIN: 边读边转存请求体, 大请求体不在读缓冲区中堆积
+           请求已完整或解析出错时不再读取, 否则没有人取走后续数据; 出错的请求响应后即关闭连接
+           停止时 socket 中可能仍有数据, 之后以 ModFd 重新注册时会再次触发 */
+        if (isET && readBuff_.ReadableBytes() >= BODY_DRAIN_SIZE &&
+            request_.parse(readBuff_) != HttpRequest::NO_REQUEST)
+        {
+            break;
+        }
     } while (isET);
     return len;
 }
@@ -85,66 +110,262 @@ ssize_t HttpConn::write(int *saveErrno)
     ssize_t len = -1;
     do
     {
-        len = writev(fd_, iov_, iovCnt_);
+        /* 一次writev发出队列中所有响应的头部与文件; iovec 止于以fd发送的文件之前, 此时队首只剩该文件 */
+        len = iovCnt_ > 0 || toWrite_ == 0 ? writev(fd_, iov_, iovCnt_) : SendFile_();
         if (len <= 0)
         {
             *saveErrno = errno;
             break;
         }
-        if (iov_[0].iov_len + iov_[1].iov_len == 0)
+        HasWritten(len);
+        if (toWrite_ == 0)
         {
             break;
         } /* 传输结束 */
-        else if (static_cast<size_t>(len) > iov_[0].iov_len)
+    } while (isET || ToWriteBytes() > 10240);
+    return len;
+}
+
+ssize_t HttpConn::SendFile_()
+{
+    const Pending &front = queue_[queueHead_];
+    assert(queueCnt_ > 0 && front.sendFile && front.headLeft == 0);
+    off_t off = front.fileOff;
+    /* 每次最多发送一段, 单次调用的耗时有上限; fd 可能与其他连接共用, 按偏移发送不改变其读写位置 */
+    ssize_t len = sendfile(fd_, front.sendFile->fd, &off, std::min(front.fileLen - front.fileOff, SENDFILE_CHUNK));
+    if (len == 0)
+    {
+        /* 文件在发送期间被截断, 已通告的长度无法满足 */
+        LOG_WARN("Client[%d] file truncated while sending", fd_);
+        errno = EIO;
+        return -1;
+    }
+    return len;
+}
+
+void HttpConn::AppendRead(const char *data, size_t len)
+{
+    readBuff_.Append(data, len);
+}
+
+void HttpConn::HasWritten(size_t len)
+{
+    assert(len <= toWrite_);
+    toWrite_ -= len;
+    while (len > 0)
+    {
+        /* 按顺序先消耗队首响应的头部, 再消耗其文件 */
+        Pending &front = queue_[queueHead_];
+        size_t n = std::min(len, front.headLeft);
+        writeBuff_.Retrieve(n);
+        front.headLeft -= n;
+        len -= n;
+        n = std::min(len, front.fileLen - front.fileOff);
+        front.fileOff += n;
+        len -= n;
+        if (front.headLeft == 0 && front.fileOff == front.fileLen)
         {
-            iov_[1].iov_base = (uint8_t *)iov_[1].iov_base + (len - iov_[0].iov_len);
-            iov_[1].iov_len -= (len - iov_[0].iov_len);
-            if (iov_[0].iov_len)
+            PopFront_();
+        }
+    }
+    BuildIov_();
+}
+
+bool HttpConn::IsQueueFull() const
+{
+    return queueCnt_ == MAX_PIPELINE;
+}
+
+void HttpConn::PopFront_()
+{
+    assert(queueCnt_ > 0);
+    Pending &front = queue_[queueHead_];
+    if (front.file && !front.cached)
+    {
+        munmap(front.file, front.fileLen);
+    }
+    front = Pending();
+    queueHead_ = (queueHead_ + 1) % MAX_PIPELINE;
+    queueCnt_--;
+}
+
+void HttpConn::ClearQueue_()
+{
+    while (queueCnt_ > 0)
+    {
+        PopFront_();
+    }
+    queueHead_ = 0;
+    toWrite_ = 0;
+    iovCnt_ = 0;
+    writeBuff_.RetrieveAll();
+}
+
+void HttpConn::BuildIov_()
+{
+    /* 头部按 writeBuff_ 中的块切分, 与各响应的文件交替排列; 放不下的留到下次writev */
+    struct iovec head[MAX_IOV];
+    int headCnt = writeBuff_.GetIov(head, MAX_IOV);
+    int hi = 0;
+    size_t hoff = 0;
+    iovCnt_ = 0;
+    for (int k = 0; k < queueCnt_; k++)
+    {
+        const Pending &item = queue_[(queueHead_ + k) % MAX_PIPELINE];
+        size_t need = item.headLeft;
+        while (need > 0 && hi < headCnt)
+        {
+            char *base = static_cast<char *>(head[hi].iov_base) + hoff;
+            size_t n = std::min(need, head[hi].iov_len - hoff);
+            if (iovCnt_ > 0 && static_cast<char *>(iov_[iovCnt_ - 1].iov_base) + iov_[iovCnt_ - 1].iov_len == base)
             {
-                writeBuff_.RetrieveAll();
-                iov_[0].iov_len = 0;
+                /* 连续的头部(如相邻的无文件响应)合并为一段 */
+                iov_[iovCnt_ - 1].iov_len += n;
+            }
+            else if (iovCnt_ < MAX_IOV)
+            {
+                iov_[iovCnt_].iov_base = base;
+                iov_[iovCnt_].iov_len = n;
+                iovCnt_++;
+            }
+            else
+            {
+                return;
+            }
+            need -= n;
+            hoff += n;
+            if (hoff == head[hi].iov_len)
+            {
+                hi++;
+                hoff = 0;
             }
         }
-        else
+        if (need > 0)
         {
-            iov_[0].iov_base = (uint8_t *)iov_[0].iov_base + len;
-            iov_[0].iov_len -= len;
-            writeBuff_.Retrieve(len);
+            return;
         }
-    } while (isET || ToWriteBytes() > 10240);
-    return len;
+        if (item.sendFile)
+        {
+            /* 文件以 sendfile 发送, 其后的响应须等它发完 */
+            return;
+        }
+        if (item.fileOff < item.fileLen)
+        {
+            if (iovCnt_ == MAX_IOV)
+            {
+                return;
+            }
+            iov_[iovCnt_].iov_base = item.file + item.fileOff;
+            iov_[iovCnt_].iov_len = item.fileLen - item.fileOff;
+            iovCnt_++;
+        }
+    }
 }
 
 bool HttpConn::process()
 {
-    request_.Init();
-    if (readBuff_.ReadableBytes() <= 0)
+    if (!parse())
     {
         return false;
     }
-    else if (request_.parse(readBuff_))
+    respond();
+    return true;
+}
+
+bool HttpConn::parse()
+{
+    /* 解析状态跨读取保留, 只在请求处理完(respond)后重置; 响应队列满时暂不解析 */
+    if (IsQueueFull())
+    {
+        return false;
+    }
+    HttpRequest::HTTP_CODE ret = request_.parse(readBuff_);
+    if (ret == HttpRequest::NO_REQUEST)
+    {
+        return false;
+    }
+    isBadRequest_ = (ret != HttpRequest::GET_REQUEST);
+    if (ret == HttpRequest::TOO_LARGE_REQUEST)
+    {
+        errorCode_ = 413;
+    }
+    else if (ret == HttpRequest::INTERNAL_ERROR)
     {
-        LOG_DEBUG("%s", request_.path().c_str());
-        response_.Init(srcDir, request_.path(), request_.IsKeepAlive(), 200);
+        errorCode_ = 500;
     }
     else
     {
-        response_.Init(srcDir, request_.path(), false, 400);
+        errorCode_ = 400;
     }
+    return true;
+}
+
+bool HttpConn::IsBlocking() const
+{
+    /* 只按缓存判断, 不在调用线程(可能是Reactor)上 open/stat; 未命中的交给线程池, 在那里打开并读入缓存 */
+    if (isBadRequest_)
+    {
+        return !HttpResponse::IsWarm(request_.path(), errorCode_);
+    }
+    if (request_.NeedVerify() || request_.NeedUpload())
+    {
+        return true;
+    }
+    return !HttpResponse::IsWarm(request_.path());
+}
 
+void HttpConn::respond()
+{
+    requestCount_++;
+    if (!isBadRequest_)
+    {
+        request_.Verify();
+        request_.Upload();
+        LOG_DEBUG("%.*s", (int)request_.path().size(), request_.path().data());
+        isKeepAlive_ = request_.IsKeepAlive() && requestCount_ < keepAliveMax;
+        response_.Init(srcDir, request_.path(), isKeepAlive_, 200);
+    }
+    else
+    {
+        isKeepAlive_ = false;
+        response_.Init(srcDir, request_.path(), false, errorCode_);
+    }
+    response_.SetKeepAliveParam(keepAliveTimeout, keepAliveMax - requestCount_);
+    response_.SetChunked(request_.version() == "1.1");
+    response_.SetHeadOnly(!isBadRequest_ && request_.method() == HttpRequest::HEAD);
+    response_.SetAcceptEncoding(request_.GetHeader(HeaderTable::ACCEPT_ENCODING));
+    if (!isBadRequest_ && (request_.method() == HttpRequest::GET || request_.method() == HttpRequest::HEAD))
+    {
+        /* If-Modified-Since 不在常用头部的表中, 按名字查找 */
+        response_.SetConditional(request_.GetHeader(HeaderTable::IF_NONE_MATCH),
+                                 request_.GetHeader("If-Modified-Since"));
+    }
+
+    /* 响应头追加到 writeBuff_ 末尾, 文件映射的所有权(或缓存项的引用)转入队列; 流水线上的多个响应按序排队 */
+    assert(!IsQueueFull());
+    size_t before = writeBuff_.ReadableBytes();
     response_.MakeResponse(writeBuff_);
-    /* 响应头 */
-    iov_[0].iov_base = const_cast<char *>(writeBuff_.Peek());
-    iov_[0].iov_len = writeBuff_.ReadableBytes();
-    iovCnt_ = 1;
+    Pending &item = queue_[(queueHead_ + queueCnt_) % MAX_PIPELINE];
+    item.headLeft = writeBuff_.ReadableBytes() - before;
+    item.fileLen = response_.File() || response_.IsSendFile() ? response_.FileLen() : 0;
+    item.sendFile = response_.TakeSendFile();
+    item.cached = response_.TakeCached();
+    item.file = item.cached ? const_cast<char *>(item.cached->body.data()) : response_.TakeFile();
+    item.fileOff = 0;
+    queueCnt_++;
+    toWrite_ += item.headLeft + item.fileLen;
+    BuildIov_();
+    LOG_DEBUG("filesize:%zu, %d responses, %d to %zu", item.fileLen, queueCnt_, iovCnt_, ToWriteBytes());
 
-    /* 文件 */
-    if (response_.FileLen() > 0 && response_.File())
+    /* 请求处理完毕: 取走其在读缓冲区中的数据(请求中的视图随之失效), 临时对象随 arena 一次性丢弃 */
+    if (isBadRequest_)
     {
-        iov_[1].iov_base = response_.File();
-        iov_[1].iov_len = response_.FileLen();
-        iovCnt_ = 2;
+        readBuff_.RetrieveAll();
     }
-    LOG_DEBUG("filesize:%d, %d  to %d", response_.FileLen(), iovCnt_, ToWriteBytes());
-    return true;
+    else
+    {
+        readBuff_.Retrieve(request_.Length());
+    }
+    request_.Init();
+    arena_.Reset();
 }
@@ -12,10 +12,15 @@
 #include <arpa/inet.h> // sockaddr_in
 #include <stdlib.h>    // atoi()
 #include <errno.h>
+#include <sys/mman.h>  // munmap
+#include <sys/sendfile.h>
+#include <atomic>
+#include <algorithm>
 
 #include "../log/log.h"
 #include "../pool/sqlconnRAII.h"
 #include "../buffer/buffer.h"
+#include "../buffer/arena.h"
 #include "httprequest.h"
 #include "httpresponse.h"
 
@@ -32,10 +37,32 @@ public:
 
     ssize_t write(int *saveErrno);
 
+    /* 由外部完成IO(如io_uring)时使用: 追加已收到的数据 / 取待发送的iovec / 确认已发送的字节
+       iovec 覆盖队列中全部待发送响应, 在下次 respond()/HasWritten() 前保持有效
+       以 sendfile 发送的文件不在 iovec 中, 外部IO时须将 HttpResponse::sendfileThreshold 设为不启用 */
+    void AppendRead(const char *data, size_t len);
+
+    const struct iovec *GetIov() const
+    {
+        return iov_;
+    }
+
+    int GetIovCnt() const
+    {
+        return iovCnt_;
+    }
+
+    void HasWritten(size_t len);
+
     void Close();
 
     int GetFd() const;
 
+    bool IsClosed() const
+    {
+        return isClose_;
+    }
+
     int GetPort() const;
 
     const char *GetIP() const;
@@ -44,32 +71,85 @@ public:
 
     bool process();
 
-    int ToWriteBytes()
+    /* process() 拆分为两步: parse() 解析请求, 无数据时返回false; respond() 生成响应
+       两步之间可用 IsBlocking() 判断响应是否可能阻塞(数据库校验, 保存上传文件或需读文件) */
+    bool parse();
+
+    bool IsBlocking() const;
+
+    /* 需查询数据库的请求(登录/注册), 应交给数据库执行通道 */
+    bool NeedDb() const
     {
-        return iov_[0].iov_len + iov_[1].iov_len;
+        return !isBadRequest_ && request_.NeedVerify();
     }
 
+    /* 生成响应并追加到发送队列末尾, 队列满时不可调用 */
+    void respond();
+
+    /* 流水线上已排队的响应数达到上限, 须先发出 */
+    bool IsQueueFull() const;
+
+    size_t ToWriteBytes() const
+    {
+        return toWrite_;
+    }
+
+    /* 由 respond() 确定: 请求协商结果且未超过单连接请求数上限 */
     bool IsKeepAlive() const
     {
-        return request_.IsKeepAlive();
+        return isKeepAlive_;
     }
 
     static bool isET;
     static const char *srcDir;
     static std::atomic<int> userCount;
+    static int keepAliveMax;     /* 单连接最多处理的请求数 */
+    static int keepAliveTimeout; /* 空闲超时(秒), 仅用于响应头通告, 由定时器执行 */
+    static const int MAX_PIPELINE = 8;               /* 单连接最多排队的响应数 */
+    static const int MAX_IOV = 16;                   /* 单次writev的最多分段数 */
+    static const size_t BODY_DRAIN_SIZE = 64 * 1024; /* 读缓冲区超过该大小时先取走已到达的请求体 */
+    static constexpr size_t SENDFILE_CHUNK = 1024 * 1024; /* 单次sendfile的最多字节数 */
 
 private:
+    /* 已生成待发送的响应: 头部位于 writeBuff_ 中(按排队顺序连续存放), 文件为独立的映射或缓存项
+       大文件不在内存中, 只持有打开的文件, 按 fileOff 以 sendfile 发送 */
+    struct Pending
+    {
+        size_t headLeft = 0; /* 头部尚未发出的字节数 */
+        char *file = nullptr;
+        StaticCache::FilePtr sendFile;
+        size_t fileLen = 0;
+        size_t fileOff = 0;           /* 文件已发出的字节数 */
+        StaticCache::EntryPtr cached; /* 非空时 file 指向其内容, 无需解除映射 */
+    };
+
+    ssize_t SendFile_();
+    void PopFront_();
+    void ClearQueue_();
+    void BuildIov_();
+
     int fd_;
     struct sockaddr_in addr_;
 
     bool isClose_;
+    bool isBadRequest_;
+    int errorCode_; /* 请求无法处理时回复的状态码 */
+    bool isKeepAlive_;
+    int requestCount_;
+
+    Pending queue_[MAX_PIPELINE];
+    int queueHead_;
+    int queueCnt_;
+    size_t toWrite_;
 
     int iovCnt_;
-    struct iovec iov_[2];
+    struct iovec iov_[MAX_IOV];
 
     Buffer readBuff_;  // 读缓冲区
     Buffer writeBuff_; // 写缓冲区
 
+    mutable Arena arena_; // 单个请求的临时内存, 须先于 request_/response_ 构造
+
     HttpRequest request_;
     HttpResponse response_;
 };
@@ -4,80 +4,387 @@
  * @copyleft Apache 2.0
  */
 #include "httprequest.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 using namespace std;
 
-const unordered_set<string> HttpRequest::DEFAULT_HTML{
-    "/index",
-    "/register",
-    "/login",
-    "/welcome",
-    "/video",
-    "/picture",
+const unordered_map<string_view, string_view> HttpRequest::DEFAULT_HTML{
+    {"/index", "/index.html"},
+    {"/register", "/register.html"},
+    {"/login", "/login.html"},
+    {"/welcome", "/welcome.html"},
+    {"/video", "/video.html"},
+    {"/picture", "/picture.html"},
 };
 
-const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG{
+const unordered_map<string_view, int> HttpRequest::DEFAULT_HTML_TAG{
     {"/register.html", 0},
     {"/login.html", 1},
 };
 
+size_t HttpRequest::maxBodySize = 8 * 1024 * 1024;
+const char *HttpRequest::uploadDir = "./upload";
+
+namespace
+{
+    /* 字符分类表: TOKEN 为RFC 7230中的tchar, CTL 为控制字符(含DEL) */
+    enum CHAR_CLASS
+    {
+        TOKEN = 1,
+        CTL = 2,
+    };
+
+    struct CharTable
+    {
+        unsigned char cls[256];
+
+        constexpr CharTable() : cls()
+        {
+            for (int c = 0; c < 256; c++)
+            {
+                bool alnum = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+                bool mark = false;
+                for (const char *m = "!#$%&'*+-.^_`|~"; *m; m++)
+                {
+                    mark = mark || c == *m;
+                }
+                cls[c] = (alnum || mark ? TOKEN : 0) | (c < 0x20 || c == 0x7f ? CTL : 0);
+            }
+        }
+    };
+
+    constexpr CharTable CHARS;
+
+    inline bool IsToken(char c)
+    {
+        return CHARS.cls[static_cast<unsigned char>(c)] & TOKEN;
+    }
+
+    /* 返回 [p, end) 中第一个控制字符的位置, 没有时返回end; 按16/32字节整块比较 */
+    const char *FindCtl(const char *p, const char *end)
+    {
+#if defined(__AVX2__)
+        const __m256i ctl32 = _mm256_set1_epi8(0x1f);
+        const __m256i del32 = _mm256_set1_epi8(0x7f);
+        for (; end - p >= 32; p += 32)
+        {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            /* 无符号 x <= 0x1f 等价于 max(x, 0x1f) == 0x1f */
+            __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, ctl32), ctl32),
+                                          _mm256_cmpeq_epi8(x, del32));
+            unsigned mask = _mm256_movemask_epi8(hit);
+            if (mask)
+            {
+                return p + __builtin_ctz(mask);
+            }
+        }
+#endif
+#if defined(__SSE2__)
+        const __m128i ctl16 = _mm_set1_epi8(0x1f);
+        const __m128i del16 = _mm_set1_epi8(0x7f);
+        for (; end - p >= 16; p += 16)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, ctl16), ctl16),
+                                       _mm_cmpeq_epi8(x, del16));
+            unsigned mask = _mm_movemask_epi8(hit);
+            if (mask)
+            {
+                return p + __builtin_ctz(mask);
+            }
+        }
+#endif
+        for (; p < end; p++)
+        {
+            if (CHARS.cls[static_cast<unsigned char>(*p)] & CTL)
+            {
+                return p;
+            }
+        }
+        return end;
+    }
+
+    /* 查找行尾CRLF, 返回'\r'的位置; 行尚不完整时返回nullptr, 行内出现除HT外的控制字符时置bad */
+    const char *FindLineEnd(const char *p, const char *end, bool &bad)
+    {
+        while (true)
+        {
+            p = FindCtl(p, end);
+            if (p == end)
+            {
+                return nullptr;
+            }
+            if (*p == '\t')
+            {
+                p++;
+                continue;
+            }
+            if (*p != '\r' || (p + 1 < end && p[1] != '\n'))
+            {
+                bad = true;
+                return nullptr;
+            }
+            return p + 1 < end ? p : nullptr;
+        }
+    }
+
+    int HexValue(char ch)
+    {
+        if (ch >= '0' && ch <= '9')
+            return ch - '0';
+        if (ch >= 'a' && ch <= 'f')
+            return ch - 'a' + 10;
+        if (ch >= 'A' && ch <= 'F')
+            return ch - 'A' + 10;
+        return -1;
+    }
+
+    /* 返回 [p, end) 中第一个 '%' 或 '+' 的位置, 没有时返回end */
+    const char *FindEscape(const char *p, const char *end)
+    {
+#if defined(__SSE2__)
+        const __m128i pct = _mm_set1_epi8('%');
+        const __m128i plus = _mm_set1_epi8('+');
+        for (; end - p >= 16; p += 16)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, pct), _mm_cmpeq_epi8(x, plus)));
+            if (mask)
+            {
+                return p + __builtin_ctz(mask);
+            }
+        }
+#endif
+        for (; p < end; p++)
+        {
+            if (*p == '%' || *p == '+')
+            {
+                return p;
+            }
+        }
+        return end;
+    }
+
+    /* application/x-www-form-urlencoded 解码: '+' 为空格, %XX 为一个字节, 不完整的 % 序列原样保留
+       两个转义之间的普通字符整段拷贝 */
+    void UrlDecode(string_view src, pmr::string &dst)
+    {
+        dst.clear();
+        dst.reserve(src.size());
+        const char *p = src.data(), *end = p + src.size();
+        while (p < end)
+        {
+            const char *q = FindEscape(p, end);
+            dst.append(p, q);
+            if (q == end)
+            {
+                break;
+            }
+            if (*q == '+')
+            {
+                dst.push_back(' ');
+                p = q + 1;
+            }
+            else if (end - q >= 3 && HexValue(q[1]) >= 0 && HexValue(q[2]) >= 0)
+            {
+                dst.push_back(static_cast<char>(HexValue(q[1]) * 16 + HexValue(q[2])));
+                p = q + 3;
+            }
+            else
+            {
+                dst.push_back('%');
+                p = q + 1;
+            }
+        }
+    }
+}
+
+HttpRequest::HttpRequest(pmr::memory_resource *arena)
+    : arena_(arena), body_(arena), header_(arena), post_(arena), multipart_(arena, &post_)
+{
+    Init();
+}
+
 void HttpRequest::Init()
 {
-    method_ = path_ = version_ = body_ = "";
+    /* 以空对象替换而非clear(), 确保不再引用 arena 中的内存(包括哈希表的桶数组) */
+    method_ = UNKNOWN_METHOD;
+    path_ = version_ = string_view();
+    body_.Reset();
+    header_.Clear();
+    post_ = StrMap(arena_);
     state_ = REQUEST_LINE;
-    header_.clear();
-    post_.clear();
+    verifyTag_ = -1;
+    upload_ = false;
+    length_ = 0;
+    base_ = nullptr;
+    offset_ = 0;
+    contentLen_ = 0;
+    isChunked_ = false;
+    chunked_.Reset();
+    multipart_.Reset();
 }
 
 bool HttpRequest::IsKeepAlive() const
 {
-    if (header_.count("Connection") == 1)
+    string_view conn = GetHeader(HeaderTable::CONNECTION);
+    if (conn.data())
     {
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
+        /* Connection 为逗号分隔的token列表, 如 "keep-alive, Upgrade" */
+        bool keepAlive = false;
+        size_t i = 0, n = conn.size();
+        while (i < n)
+        {
+            size_t j = conn.find(',', i);
+            if (j == string_view::npos)
+            {
+                j = n;
+            }
+            size_t l = i, r = j;
+            while (l < r && (conn[l] == ' ' || conn[l] == '\t'))
+                l++;
+            while (r > l && (conn[r - 1] == ' ' || conn[r - 1] == '\t'))
+                r--;
+            if (EqualsIgnoreCase(conn.data() + l, r - l, "close", 5))
+            {
+                return false;
+            }
+            if (EqualsIgnoreCase(conn.data() + l, r - l, "keep-alive", 10))
+            {
+                keepAlive = true;
+            }
+            i = j + 1;
+        }
+        if (keepAlive)
+        {
+            return version_ == "1.1" || version_ == "1.0";
+        }
     }
-    return false;
+    return version_ == "1.1";
 }
 
-bool HttpRequest::parse(Buffer &buff)
+bool HttpRequest::EqualsIgnoreCase(const char *a, size_t lenA, const char *b, size_t lenB)
 {
-    const char CRLF[] = "\r\n";
-    if (buff.ReadableBytes() <= 0)
+    return lenA == lenB && strncasecmp(a, b, lenA) == 0;
+}
+
+HttpRequest::HTTP_CODE HttpRequest::parse(Buffer &buff)
+{
+    if (state_ == FINISH)
     {
-        return false;
+        /* 已解析完但尚未处理(如等待前面的响应发完), 重复调用结果不变 */
+        return GET_REQUEST;
+    }
+    if (state_ == BODY)
+    {
+        return ParseBody_(buff);
     }
-    while (buff.ReadableBytes() && state_ != FINISH)
+    if (buff.ReadableBytes() <= offset_)
     {
-        const char *lineEnd = search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
-        std::string line(buff.Peek(), lineEnd);
+        return NO_REQUEST;
+    }
+    const char *begin = buff.Peek();
+    if (base_ && begin != base_)
+    {
+        Rebase_(begin);
+    }
+    base_ = begin;
+    const char *end = begin + buff.ReadableBytes();
+    const char *p = begin + offset_;
+    while (state_ == REQUEST_LINE || state_ == HEADERS)
+    {
+        bool bad = false;
+        const char *lineEnd = FindLineEnd(p, end, bad);
+        if (bad)
+        {
+            LOG_ERROR("Invalid character in request");
+            return BAD_REQUEST;
+        }
+        if (static_cast<size_t>((lineEnd ? lineEnd + 2 : end) - begin) > MAX_HEADER_SIZE)
+        {
+            LOG_WARN("Request header too large");
+            return BAD_REQUEST;
+        }
+        if (lineEnd == nullptr)
+        {
+            /* 行不完整: 保留状态, 下次从该行开头继续 */
+            break;
+        }
         switch (state_)
         {
         case REQUEST_LINE:
-            if (!ParseRequestLine_(line))
+            if (!ParseRequestLine_(p, lineEnd))
             {
-                return false;
+                return BAD_REQUEST;
             }
             ParsePath_();
             break;
         case HEADERS:
-            ParseHeader_(line);
-            if (buff.ReadableBytes() <= 2)
+            if (lineEnd == p)
             {
-                state_ = FINISH;
+                /* 空行: 头部结束, 确定请求体的定界方式 */
+                HTTP_CODE ret = ParseFraming_();
+                if (ret != GET_REQUEST)
+                {
+                    return ret;
+                }
+            }
+            else if (!ParseHeader_(p, lineEnd))
+            {
+                LOG_ERROR("Header Error");
+                return BAD_REQUEST;
             }
-            break;
-        case BODY:
-            ParseBody_(line);
             break;
         default:
             break;
         }
-        if (lineEnd == buff.BeginWrite())
+        /* 每解析完一行即记录进度: 出错返回后再次调用会停在同一行, 得到同样的结果 */
+        p = lineEnd + 2;
+        offset_ = p - begin;
+    }
+    if (state_ == BODY)
+    {
+        if (!body_.Open(isChunked_ ? 0 : contentLen_))
         {
-            break;
+            return INTERNAL_ERROR;
+        }
+        if (multipart_.Active())
+        {
+            body_.SetListener(&multipart_);
         }
-        buff.RetrieveUntil(lineEnd + 2);
+        DetachHeader_(buff);
+        return ParseBody_(buff);
     }
-    LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
-    return true;
+    if (state_ != FINISH)
+    {
+        return NO_REQUEST;
+    }
+    length_ = offset_;
+    LOG_DEBUG("[%d], [%.*s], [%.*s]", method_, (int)path_.size(), path_.data(), (int)version_.size(), version_.data());
+    return GET_REQUEST;
+}
+
+void HttpRequest::Rebase_(const char *base)
+{
+    /* 只平移位于已解析区间内的视图, 指向静态字符串的路径保持不变 */
+    uintptr_t lo = reinterpret_cast<uintptr_t>(base_);
+    uintptr_t hi = lo + offset_;
+    auto move = [&](string_view v)
+    {
+        uintptr_t addr = reinterpret_cast<uintptr_t>(v.data());
+        if (v.data() == nullptr || addr < lo || addr > hi)
+        {
+            return v;
+        }
+        return string_view(base + (addr - lo), v.size());
+    };
+    path_ = move(path_);
+    version_ = move(version_);
+    header_.Remap(move);
 }
 
 void HttpRequest::ParsePath_()
@@ -88,138 +395,372 @@ void HttpRequest::ParsePath_()
     }
     else
     {
-        for (auto &item : DEFAULT_HTML)
+        auto it = DEFAULT_HTML.find(path_);
+        if (it != DEFAULT_HTML.end())
+        {
+            path_ = it->second;
+        }
+    }
+}
+
+HttpRequest::METHOD HttpRequest::ParseMethod_(string_view token)
+{
+    static const string_view NAMES[] = {"GET", "HEAD", "POST", "PUT", "DELETE",
+                                        "CONNECT", "OPTIONS", "TRACE", "PATCH"};
+    for (int i = 0; i < UNKNOWN_METHOD; i++)
+    {
+        if (token == NAMES[i])
+        {
+            return static_cast<METHOD>(i);
+        }
+    }
+    return UNKNOWN_METHOD;
+}
+
+bool HttpRequest::ParseRequestLine_(const char *begin, const char *end)
+{
+    /* method SP request-target SP HTTP/version */
+    const char *p = begin;
+    while (p < end && IsToken(*p))
+    {
+        p++;
+    }
+    if (p == begin || p == end || *p != ' ')
+    {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    method_ = ParseMethod_(string_view(begin, p - begin));
+    const char *target = ++p;
+    while (p < end && static_cast<unsigned char>(*p) > ' ')
+    {
+        p++;
+    }
+    if (p == target || p == end || *p != ' ')
+    {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    path_ = string_view(target, p - target);
+    p++;
+    if (end - p <= 5 || memcmp(p, "HTTP/", 5) != 0)
+    {
+        LOG_ERROR("RequestLine Error");
+        return false;
+    }
+    for (const char *v = p + 5; v < end; v++)
+    {
+        if (static_cast<unsigned char>(*v) <= ' ')
         {
-            if (item == path_)
+            LOG_ERROR("RequestLine Error");
+            return false;
+        }
+    }
+    version_ = string_view(p + 5, end - p - 5);
+    state_ = HEADERS;
+    return true;
+}
+
+bool HttpRequest::ParseHeader_(const char *begin, const char *end)
+{
+    /* field-name ":" OWS field-value OWS, 值的空白留到读取时再去除 */
+    const char *p = begin;
+    while (p < end && IsToken(*p))
+    {
+        p++;
+    }
+    if (p == begin || p == end || *p != ':')
+    {
+        return false;
+    }
+    if (!header_.Add(string_view(begin, p - begin), string_view(p + 1, end - p - 1)))
+    {
+        LOG_ERROR("Duplicate header: %.*s", (int)(p - begin), begin);
+        return false;
+    }
+    return true;
+}
+
+HttpRequest::HTTP_CODE HttpRequest::ParseFraming_()
+{
+    /* Transfer-Encoding 优先于 Content-Length(RFC 7230 3.3.3); 两者同时出现可能是请求走私, 直接拒绝 */
+    string_view te = GetHeader(HeaderTable::TRANSFER_ENCODING);
+    string_view len = GetHeader(HeaderTable::CONTENT_LENGTH);
+    if (te.data())
+    {
+        if (len.data())
+        {
+            LOG_ERROR("Both Transfer-Encoding and Content-Length present");
+            return BAD_REQUEST;
+        }
+        if (!EqualsIgnoreCase(te.data(), te.size(), "chunked", 7))
+        {
+            LOG_ERROR("Unsupported Transfer-Encoding");
+            return BAD_REQUEST;
+        }
+        isChunked_ = true;
+        state_ = BODY;
+    }
+    size_t contentLen = 0;
+    if (!isChunked_ && len.data())
+    {
+        if (len.empty() || len.size() > 18)
+        {
+            LOG_ERROR("Invalid Content-Length");
+            return BAD_REQUEST;
+        }
+        for (char c : len)
+        {
+            if (c < '0' || c > '9')
             {
-                path_ += ".html";
-                break;
+                LOG_ERROR("Invalid Content-Length");
+                return BAD_REQUEST;
             }
+            contentLen = contentLen * 10 + (c - '0');
         }
     }
+    if (contentLen > maxBodySize)
+    {
+        LOG_WARN("Request body too large: %zu", contentLen);
+        return TOO_LARGE_REQUEST;
+    }
+    if (!isChunked_)
+    {
+        contentLen_ = contentLen;
+        state_ = contentLen_ > 0 ? BODY : FINISH;
+    }
+    /* multipart 表单随请求体到达流式解析 */
+    string_view type = GetHeader(HeaderTable::CONTENT_TYPE);
+    if (state_ == BODY && method_ == POST && type.size() >= 19 && strncasecmp(type.data(), "multipart/form-data", 19) == 0 &&
+        !multipart_.Begin(type))
+    {
+        return BAD_REQUEST;
+    }
+    return GET_REQUEST;
 }
 
-bool HttpRequest::ParseRequestLine_(const string &line)
+void HttpRequest::DetachHeader_(Buffer &buff)
 {
-    regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, patten))
-    {
-        method_ = subMatch[1];
-        path_ = subMatch[2];
-        version_ = subMatch[3];
-        state_ = HEADERS;
-        return true;
-    }
-    LOG_ERROR("RequestLine Error");
-    return false;
+    /* 头部拷入 arena 后从读缓冲区取走, 之后读缓冲区开头即是请求体 */
+    char *copy = static_cast<char *>(arena_->allocate(offset_, 1));
+    memcpy(copy, base_, offset_);
+    Rebase_(copy);
+    buff.Retrieve(offset_);
+    base_ = nullptr;
+    offset_ = 0;
 }
 
-void HttpRequest::ParseHeader_(const string &line)
+HttpRequest::HTTP_CODE HttpRequest::ParseBody_(Buffer &buff)
 {
-    regex patten("^([^:]*): ?(.*)$");
-    smatch subMatch;
-    if (regex_match(line, subMatch, patten))
+    /* 按块取出请求体, 不合并读缓冲区; 只取本请求的部分, 其后的流水线请求留在缓冲区 */
+    if (isChunked_)
     {
-        header_[subMatch[1]] = subMatch[2];
+        return ParseChunked_(buff);
     }
-    else
+    struct iovec iov[16];
+    while (body_.Size() < contentLen_ && buff.ReadableBytes() > 0)
     {
-        state_ = BODY;
+        int cnt = buff.GetIov(iov, 16);
+        size_t taken = 0;
+        for (int i = 0; i < cnt && body_.Size() < contentLen_; i++)
+        {
+            size_t n = std::min(iov[i].iov_len, contentLen_ - body_.Size());
+            if (!body_.Append(static_cast<const char *>(iov[i].iov_base), n))
+            {
+                return INTERNAL_ERROR;
+            }
+            taken += n;
+        }
+        buff.Retrieve(taken);
     }
+    if (body_.Size() < contentLen_)
+    {
+        return NO_REQUEST;
+    }
+    return FinishBody_();
 }
 
-void HttpRequest::ParseBody_(const string &line)
+HttpRequest::HTTP_CODE HttpRequest::ParseChunked_(Buffer &buff)
 {
-    body_ = line;
-    ParsePost_();
-    state_ = FINISH;
-    LOG_DEBUG("Body:%s, len:%d", line.c_str(), line.size());
+    /* 解码器只取走属于本请求的字节, 结束块之后的流水线请求留在缓冲区 */
+    struct iovec iov[16];
+    ChunkedDecoder::STATUS status = ChunkedDecoder::NEED_MORE;
+    while (status == ChunkedDecoder::NEED_MORE && buff.ReadableBytes() > 0)
+    {
+        int cnt = buff.GetIov(iov, 16);
+        size_t taken = 0;
+        for (int i = 0; i < cnt && status == ChunkedDecoder::NEED_MORE; i++)
+        {
+            size_t used = 0;
+            status = chunked_.Decode(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len,
+                                     used, body_, maxBodySize);
+            taken += used;
+        }
+        buff.Retrieve(taken);
+    }
+    switch (status)
+    {
+    case ChunkedDecoder::NEED_MORE:
+        return NO_REQUEST;
+    case ChunkedDecoder::DONE:
+        contentLen_ = body_.Size();
+        return FinishBody_();
+    case ChunkedDecoder::TOO_LARGE:
+        return TOO_LARGE_REQUEST;
+    case ChunkedDecoder::WRITE_ERROR:
+        return INTERNAL_ERROR;
+    default:
+        return BAD_REQUEST;
+    }
 }
 
-int HttpRequest::ConverHex(char ch)
+HttpRequest::HTTP_CODE HttpRequest::FinishBody_()
 {
-    if (ch >= 'A' && ch <= 'F')
-        return ch - 'A' + 10;
-    if (ch >= 'a' && ch <= 'f')
-        return ch - 'a' + 10;
-    return ch;
+    if (multipart_.Active() && !multipart_.Complete())
+    {
+        LOG_ERROR("Malformed multipart body");
+        return BAD_REQUEST;
+    }
+    ParsePost_();
+    state_ = FINISH;
+    length_ = 0;
+    LOG_DEBUG("Body len:%zu, in memory:%d", body_.Size(), body_.InMemory());
+    return GET_REQUEST;
 }
 
 void HttpRequest::ParsePost_()
 {
-    if (method_ == "POST" && header_["Content-Type"] == "application/x-www-form-urlencoded")
+    if (method_ != POST)
+    {
+        return;
+    }
+    /* multipart 字段已在接收请求体时写入 post_; urlencoded 表单只在内存中解析, 转存到文件的大请求体留给处理方按段读取 */
+    string_view type = GetHeader(HeaderTable::CONTENT_TYPE);
+    type = type.substr(0, type.find(';'));
+    while (!type.empty() && (type.back() == ' ' || type.back() == '\t'))
     {
-        ParseFromUrlencoded_();
-        if (DEFAULT_HTML_TAG.count(path_))
+        type.remove_suffix(1);
+    }
+    bool urlencoded = EqualsIgnoreCase(type.data(), type.size(), "application/x-www-form-urlencoded", 33);
+    if (multipart_.Active() || (urlencoded && body_.InMemory()))
+    {
+        if (urlencoded)
+        {
+            ParseFromUrlencoded_();
+        }
+        auto it = DEFAULT_HTML_TAG.find(path_);
+        if (it != DEFAULT_HTML_TAG.end())
         {
-            int tag = DEFAULT_HTML_TAG.find(path_)->second;
+            int tag = it->second;
             LOG_DEBUG("Tag:%d", tag);
             if (tag == 0 || tag == 1)
             {
-                bool isLogin = (tag == 1);
-                if (UserVerify(post_["username"], post_["password"], isLogin))
-                {
-                    path_ = "/welcome.html";
-                }
-                else
-                {
-                    path_ = "/error.html";
-                }
+                /* 数据库校验推迟到 Verify(), 由调用方决定在哪个线程执行 */
+                verifyTag_ = tag;
             }
         }
     }
+    if (multipart_.Active() && path_ == "/upload")
+    {
+        /* 文件写入推迟到 Upload(), 与数据库校验一样由调用方决定在哪个线程执行 */
+        upload_ = true;
+    }
 }
 
-void HttpRequest::ParseFromUrlencoded_()
+void HttpRequest::Verify()
 {
-    if (body_.size() == 0)
+    if (verifyTag_ < 0)
     {
         return;
     }
+    bool isLogin = (verifyTag_ == 1);
+    if (UserVerify(post_[pmr::string("username", arena_)], post_[pmr::string("password", arena_)], isLogin))
+    {
+        path_ = "/welcome.html";
+    }
+    else
+    {
+        path_ = "/error.html";
+    }
+    verifyTag_ = -1;
+}
 
-    string key, value;
-    int num = 0;
-    int n = body_.size();
-    int i = 0, j = 0;
+void HttpRequest::Upload()
+{
+    if (!upload_)
+    {
+        return;
+    }
+    bool ok = !files().empty();
+    for (const auto &part : files())
+    {
+        ok = ok && SaveUpload_(part);
+    }
+    path_ = ok ? "/welcome.html" : "/error.html";
+    upload_ = false;
+}
 
-    for (; i < n; i++)
+bool HttpRequest::SaveUpload_(const MultipartParser::FilePart &part) const
+{
+    /* 只取客户端文件名的最后一段, 不允许写到 uploadDir 之外 */
+    string_view name = part.filename;
+    size_t slash = name.find_last_of("/\\");
+    if (slash != string_view::npos)
     {
-        char ch = body_[i];
-        switch (ch)
-        {
-        case '=':
-            key = body_.substr(j, i - j);
-            j = i + 1;
-            break;
-        case '+':
-            body_[i] = ' ';
-            break;
-        case '%':
-            num = ConverHex(body_[i + 1]) * 16 + ConverHex(body_[i + 2]);
-            body_[i + 2] = num % 10 + '0';
-            body_[i + 1] = num / 10 + '0';
-            i += 2;
-            break;
-        case '&':
-            value = body_.substr(j, i - j);
-            j = i + 1;
-            post_[key] = value;
-            LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
-            break;
-        default:
-            break;
-        }
+        name.remove_prefix(slash + 1);
+    }
+    if (name.empty() || name == "." || name == ".." || name.find('\0') != string_view::npos)
+    {
+        LOG_WARN("Invalid upload file name: %s", part.filename.c_str());
+        return false;
+    }
+    char file[PATH_MAX];
+    int len = snprintf(file, sizeof(file), "%s/%.*s", uploadDir, (int)name.size(), name.data());
+    if (len < 0 || static_cast<size_t>(len) >= sizeof(file))
+    {
+        LOG_WARN("Upload file name too long");
+        return false;
+    }
+    int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        LOG_ERROR("Open upload file %s failed, errno:%d", file, errno);
+        return false;
     }
-    assert(j <= i);
-    if (post_.count(key) == 0 && j < i)
+    bool ok = SaveFile(part, fd);
+    close(fd);
+    if (!ok)
     {
-        value = body_.substr(j, i - j);
+        unlink(file);
+        return false;
+    }
+    LOG_INFO("Upload %s, %zu bytes", file, part.length);
+    return true;
+}
+
+void HttpRequest::ParseFromUrlencoded_()
+{
+    /* 先按 '&' 与 '=' 切分再分别解码, 值中编码的 "%26" 不会被当作分隔符 */
+    string_view body = body_.Data();
+    pmr::string key(arena_), value(arena_);
+    while (!body.empty())
+    {
+        size_t amp = body.find('&');
+        string_view pair = body.substr(0, amp);
+        body.remove_prefix(amp == string_view::npos ? body.size() : amp + 1);
+        if (pair.empty())
+        {
+            continue;
+        }
+        size_t eq = pair.find('=');
+        UrlDecode(pair.substr(0, eq), key);
+        UrlDecode(eq == string_view::npos ? string_view() : pair.substr(eq + 1), value);
         post_[key] = value;
+        LOG_DEBUG("%s = %s", key.c_str(), value.c_str());
     }
 }
 
-bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin)
+bool HttpRequest::UserVerify(const pmr::string &name, const pmr::string &pwd, bool isLogin)
 {
     if (name == "" || pwd == "")
     {
@@ -256,11 +797,11 @@ bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin
     while (MYSQL_ROW row = mysql_fetch_row(res))
     {
         LOG_DEBUG("MYSQL ROW: %s %s", row[0], row[1]);
-        string password(row[1]);
+        string_view password(row[1]);
         /* 注册行为 且 用户名未被使用*/
         if (isLogin)
         {
-            if (pwd == password)
+            if (string_view(pwd) == password)
             {
                 flag = true;
             }
@@ -297,21 +838,17 @@ bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin
     return flag;
 }
 
-std::string HttpRequest::path() const
+string_view HttpRequest::path() const
 {
     return path_;
 }
 
-std::string &HttpRequest::path()
-{
-    return path_;
-}
-std::string HttpRequest::method() const
+HttpRequest::METHOD HttpRequest::method() const
 {
     return method_;
 }
 
-std::string HttpRequest::version() const
+string_view HttpRequest::version() const
 {
     return version_;
 }
@@ -319,19 +856,16 @@ std::string HttpRequest::version() const
 std::string HttpRequest::GetPost(const std::string &key) const
 {
     assert(key != "");
-    if (post_.count(key) == 1)
-    {
-        return post_.find(key)->second;
-    }
-    return "";
+    return GetPost(key.c_str());
 }
 
 std::string HttpRequest::GetPost(const char *key) const
 {
     assert(key != nullptr);
-    if (post_.count(key) == 1)
+    auto it = post_.find(pmr::string(key, arena_));
+    if (it != post_.end())
     {
-        return post_.find(key)->second;
+        return std::string(it->second.data(), it->second.size());
     }
     return "";
 }
\ No newline at end of file
@@ -7,12 +7,19 @@
 #define HTTP_REQUEST_H
 
 #include <unordered_map>
-#include <unordered_set>
 #include <string>
-#include <regex>
+#include <string_view>
+#include <memory_resource>
 #include <errno.h>
+#include <strings.h>      // strncasecmp
+#include <fcntl.h>        // open
+#include <limits.h>       // PATH_MAX
 #include <mysql/mysql.h> //mysql
 
+#include "headertable.h"
+#include "requestbody.h"
+#include "chunkeddecoder.h"
+#include "multipartparser.h"
 #include "../buffer/buffer.h"
 #include "../log/log.h"
 #include "../pool/sqlconnpool.h"
@@ -29,6 +36,20 @@ public:
         FINISH,
     };
 
+    enum METHOD
+    {
+        GET = 0,
+        HEAD,
+        POST,
+        PUT,
+        DELETE,
+        CONNECT,
+        OPTIONS,
+        TRACE,
+        PATCH,
+        UNKNOWN_METHOD,
+    };
+
     enum HTTP_CODE
     {
         NO_REQUEST = 0,
@@ -39,23 +60,57 @@ public:
         FILE_REQUEST,
         INTERNAL_ERROR,
         CLOSED_CONNECTION,
+        TOO_LARGE_REQUEST,
     };
 
-    HttpRequest() { Init(); }
+    /* 请求期间的字符串与容器都分配自 arena, 由持有者在请求结束时整体重置
+       path/version/头部为指向读缓冲区的视图, 请求处理完之前调用方不得取走这部分数据
+       带请求体时头部先拷入 arena 并从读缓冲区取走, 请求体随到随取, 不在读缓冲区中堆积
+       请求体按 Content-Length 定界, 或按 Transfer-Encoding: chunked 增量解码 */
+    explicit HttpRequest(std::pmr::memory_resource *arena = std::pmr::get_default_resource());
     ~HttpRequest() = default;
 
+    /* 重建全部成员, 之后持有者才可重置 arena */
     void Init();
-    bool parse(Buffer &buff);
 
-    std::string path() const;
-    std::string &path();
-    std::string method() const;
-    std::string version() const;
+    /* 就地解析缓冲区开头的请求, 头部不取走, 请求体边解析边取走; 可跨多次读取续解析, 从上次停下的位置继续
+       返回 GET_REQUEST: 请求完整; NO_REQUEST: 数据不足, 等待更多数据; BAD_REQUEST: 格式错误或头部超限
+       TOO_LARGE_REQUEST: Content-Length 超过 maxBodySize; INTERNAL_ERROR: 请求体无法转存 */
+    HTTP_CODE parse(Buffer &buff);
+
+    /* 本次请求仍留在读缓冲区中的字节数, 处理完后由调用方取走 */
+    size_t Length() const { return length_; }
+
+    std::string_view path() const;
+    METHOD method() const;
+    std::string_view version() const;
     std::string GetPost(const std::string &key) const;
     std::string GetPost(const char *key) const;
+    const RequestBody &body() const { return body_; }
+
+    /* multipart 表单中的文件部分, 普通字段与 urlencoded 表单一样经 GetPost 读取 */
+    const MultipartParser::FileList &files() const { return multipart_.Files(); }
+    /* 把文件部分的内容写入 fd; 请求体在临时文件中时由内核直接拷贝 */
+    bool SaveFile(const MultipartParser::FilePart &part, int fd) const { return body_.CopyTo(fd, part.offset, part.length); }
+
+    /* POST /upload 的 multipart 表单: 文件部分写入 uploadDir, 会阻塞调用线程 */
+    bool NeedUpload() const { return upload_; }
+    void Upload();
 
+    /* 按RFC 7230协商持久连接: 1.1默认持久, 1.0需显式keep-alive, close优先 */
     bool IsKeepAlive() const;
 
+    /* 头部名大小写不敏感查找, 值已去除首尾空白; 不存在时返回 data() 为 nullptr 的空视图 */
+    std::string_view GetHeader(HeaderTable::HEADER_ID id) const { return header_.Get(id); }
+    std::string_view GetHeader(std::string_view key) const { return header_.Get(key); }
+
+    /* 登录/注册请求需查询数据库, 会阻塞调用线程 */
+    bool NeedVerify() const { return verifyTag_ >= 0; }
+    void Verify();
+
+    static size_t maxBodySize; /* Content-Length 上限, 超出时不接收请求体 */
+    static const char *uploadDir; /* 上传文件的存放目录 */
+
     /*
     todo
     void HttpConn::ParseFormData() {}
@@ -63,24 +118,50 @@ public:
     */
 
 private:
-    bool ParseRequestLine_(const std::string &line);
-    void ParseHeader_(const std::string &line);
-    void ParseBody_(const std::string &line);
+    bool ParseRequestLine_(const char *begin, const char *end);
+    bool ParseHeader_(const char *begin, const char *end);
+    HTTP_CODE ParseFraming_();
+    HTTP_CODE ParseBody_(Buffer &buff);
+    HTTP_CODE ParseChunked_(Buffer &buff);
+    HTTP_CODE FinishBody_();
+    void DetachHeader_(Buffer &buff);
 
     void ParsePath_();
     void ParsePost_();
     void ParseFromUrlencoded_();
 
-    static bool UserVerify(const std::string &name, const std::string &pwd, bool isLogin);
+    bool SaveUpload_(const MultipartParser::FilePart &part) const;
+
+    static bool UserVerify(const std::pmr::string &name, const std::pmr::string &pwd, bool isLogin);
+
+    static METHOD ParseMethod_(std::string_view token);
+
+    /* 读缓冲区整理后数据起点移动, 把已解析部分的视图平移到新位置 */
+    void Rebase_(const char *base);
+
+    typedef MultipartParser::FieldMap StrMap;
 
+    std::pmr::memory_resource *arena_;
     PARSE_STATE state_;
-    std::string method_, path_, version_, body_;
-    std::unordered_map<std::string, std::string> header_;
-    std::unordered_map<std::string, std::string> post_;
+    int verifyTag_; /* -1: 无需校验 0: 注册 1: 登录 */
+    bool upload_;   /* 有待写入 uploadDir 的文件部分 */
+    METHOD method_;
+    std::string_view path_, version_;
+    RequestBody body_;
+    size_t length_;
+    const char *base_;  /* 上次解析时读缓冲区的起点 */
+    size_t offset_;     /* 已解析到的位置(相对起点) */
+    size_t contentLen_; /* 请求体长度, 头部解析完成后确定; chunked 时为解码后的长度 */
+    bool isChunked_;
+    ChunkedDecoder chunked_;
+    HeaderTable header_;
+    StrMap post_;
+    MultipartParser multipart_;
 
-    static const std::unordered_set<std::string> DEFAULT_HTML;
-    static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
-    static int ConverHex(char ch);
+    static const std::unordered_map<std::string_view, std::string_view> DEFAULT_HTML;
+    static const std::unordered_map<std::string_view, int> DEFAULT_HTML_TAG;
+    static const size_t MAX_HEADER_SIZE = 8192; /* 请求行与头部的总长度上限 */
+    static bool EqualsIgnoreCase(const char *a, size_t lenA, const char *b, size_t lenB);
 };
 
 #endif // HTTP_REQUEST_H
\ No newline at end of file
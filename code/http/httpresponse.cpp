@@ -5,50 +5,109 @@
  */
 #include "httpresponse.h"
 
+#include <string.h>
+#include <strings.h> // strncasecmp
+#include <time.h>    // strptime, timegm
+
 using namespace std;
 
-const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
-    {".html", "text/html"},
-    {".xml", "text/xml"},
-    {".xhtml", "application/xhtml+xml"},
-    {".txt", "text/plain"},
-    {".rtf", "application/rtf"},
-    {".pdf", "application/pdf"},
-    {".word", "application/nsword"},
-    {".png", "image/png"},
-    {".gif", "image/gif"},
-    {".jpg", "image/jpeg"},
-    {".jpeg", "image/jpeg"},
-    {".au", "audio/basic"},
-    {".mpeg", "video/mpeg"},
-    {".mpg", "video/mpeg"},
-    {".avi", "video/x-msvideo"},
-    {".gz", "application/x-gzip"},
-    {".tar", "application/x-tar"},
-    {".css", "text/css "},
-    {".js", "text/javascript "},
+size_t HttpResponse::sendfileThreshold = 1024 * 1024;
+
+namespace
+{
+    /* Cache-Control 的 max-age(秒) */
+    const int NO_CACHE = 0;
+    const int HOUR = 3600;
+    const int DAY = 24 * HOUR;
+    const int WEEK = 7 * DAY;
+    const int MONTH = 30 * DAY;
+
+    string_view Trim(string_view v)
+    {
+        while (!v.empty() && (v.front() == ' ' || v.front() == '\t'))
+        {
+            v.remove_prefix(1);
+        }
+        while (!v.empty() && (v.back() == ' ' || v.back() == '\t'))
+        {
+            v.remove_suffix(1);
+        }
+        return v;
+    }
+}
+
+/* 未知后缀按纯文本发送 */
+const HttpResponse::FileType HttpResponse::DEFAULT_TYPE = {"text/plain", NO_CACHE};
+
+/* 页面每次都验证; 可能随页面改动的样式与脚本缓存较短, 图片与字体缓存较长 */
+const unordered_map<string_view, HttpResponse::FileType> HttpResponse::SUFFIX_TYPE = {
+    {".html", {"text/html", NO_CACHE}},
+    {".xml", {"text/xml", NO_CACHE}},
+    {".xhtml", {"application/xhtml+xml", NO_CACHE}},
+    {".txt", {"text/plain", NO_CACHE}},
+    {".rtf", {"application/rtf", DAY}},
+    {".pdf", {"application/pdf", DAY}},
+    {".word", {"application/nsword", DAY}},
+    {".png", {"image/png", WEEK}},
+    {".gif", {"image/gif", WEEK}},
+    {".jpg", {"image/jpeg", WEEK}},
+    {".jpeg", {"image/jpeg", WEEK}},
+    {".au", {"audio/basic", DAY}},
+    {".mpeg", {"video/mpeg", DAY}},
+    {".mpg", {"video/mpeg", DAY}},
+    {".avi", {"video/x-msvideo", DAY}},
+    {".gz", {"application/x-gzip", DAY}},
+    {".tar", {"application/x-tar", DAY}},
+    {".css", {"text/css ", HOUR}},
+    {".js", {"text/javascript ", HOUR}},
+    {".svg", {"image/svg+xml", WEEK}},
+    {".ttf", {"font/ttf", MONTH}},
+    {".otf", {"font/otf", MONTH}},
+    {".eot", {"application/vnd.ms-fontobject", MONTH}},
+    {".woff", {"font/woff", MONTH}},
+    {".woff2", {"font/woff2", MONTH}},
 };
 
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
     {200, "OK"},
+    {304, "Not Modified"},
     {400, "Bad Request"},
     {403, "Forbidden"},
     {404, "Not Found"},
+    {413, "Payload Too Large"},
+    {500, "Internal Server Error"},
 };
 
+const unordered_map<int, string> HttpResponse::STATUS_LINE = []
+{
+    unordered_map<int, string> lines;
+    for (auto &item : CODE_STATUS)
+    {
+        lines[item.first] = "HTTP/1.1 " + to_string(item.first) + " " + item.second + "\r\n";
+    }
+    return lines;
+}();
+
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
     {400, "/400.html"},
     {403, "/403.html"},
     {404, "/404.html"},
 };
 
-HttpResponse::HttpResponse()
+HttpResponse::HttpResponse(pmr::memory_resource *arena) : arena_(arena)
 {
     code_ = -1;
-    path_ = srcDir_ = "";
+    path_ = srcDir_ = string_view();
     isKeepAlive_ = false;
+    chunked_ = false;
+    headOnly_ = false;
+    acceptEncoding_ = 0;
+    vary_ = false;
+    etagEncoding_ = -1;
+    keepAliveTimeout_ = keepAliveLeft_ = 0;
     mmFile_ = nullptr;
     mmFileStat_ = {0};
+    sendfile_ = false;
 };
 
 HttpResponse::~HttpResponse()
@@ -56,50 +115,297 @@ HttpResponse::~HttpResponse()
     UnmapFile();
 }
 
-void HttpResponse::Init(const string &srcDir, string &path, bool isKeepAlive, int code)
+void HttpResponse::Init(string_view srcDir, string_view path, bool isKeepAlive, int code)
 {
-    assert(srcDir != "");
-    if (mmFile_)
-    {
-        UnmapFile();
-    }
+    assert(!srcDir.empty());
+    UnmapFile();
     code_ = code;
     isKeepAlive_ = isKeepAlive;
+    chunked_ = false;
+    headOnly_ = false;
+    acceptEncoding_ = 0;
+    vary_ = false;
+    ifNoneMatch_ = ifModifiedSince_ = string_view();
+    etagEncoding_ = -1;
     path_ = path;
     srcDir_ = srcDir;
-    mmFile_ = nullptr;
     mmFileStat_ = {0};
 }
 
+void HttpResponse::SetKeepAliveParam(int timeoutSec, int maxLeft)
+{
+    keepAliveTimeout_ = timeoutSec;
+    keepAliveLeft_ = maxLeft;
+}
+
 void HttpResponse::MakeResponse(Buffer &buff)
 {
-    /* 判断请求的资源文件 */
-    if (stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode))
+    /* 判断请求的资源文件; 调用方已给出错误状态(如400)时直接使用对应的错误页
+       缓存命中时省去 stat/open/mmap, 未命中的小文件读入缓存
+       条件请求先只查表, 以缓存项或打开文件缓存中的 stat 校验, 未修改时不读入内容, 否则再取缓存项 */
+    bool conditional = !ifNoneMatch_.empty() || !ifModifiedSince_.empty();
+    if (code_ == -1 || code_ == 200)
     {
-        code_ = 404;
+        if (conditional)
+        {
+            cached_ = StaticCache::Instance()->Find(path_);
+        }
+        else
+        {
+            cached_ = StaticCache::Instance()->Get(path_, GetFileType_());
+        }
+        if (cached_)
+        {
+            code_ = 200;
+            mmFileStat_ = cached_->st;
+        }
+        else
+        {
+            /* 打开文件缓存同时记下不存在的路径, 重复请求不再 open/stat */
+            file_ = StaticCache::Instance()->Open(srcDir_, path_);
+            mmFileStat_ = file_->st;
+            code_ = FileStatus_(*file_);
+        }
+        if (code_ == 200 && conditional)
+        {
+            if (NotModified_())
+            {
+                code_ = 304;
+                cached_.reset();
+                file_.reset();
+            }
+            else if (!cached_)
+            {
+                cached_ = StaticCache::Instance()->Get(path_, GetFileType_());
+                if (cached_)
+                {
+                    file_.reset();
+                }
+            }
+        }
     }
-    else if (!(mmFileStat_.st_mode & S_IROTH))
+    if (code_ == 200)
     {
-        code_ = 403;
+        Negotiate_();
     }
-    else if (code_ == -1)
+    else if (code_ == 304)
     {
-        code_ = 200;
+        vary_ = IsCompressible_(GetFileType_());
     }
     ErrorHtml_();
     AddStateLine_(buff);
     AddHeader_(buff);
     AddContent_(buff);
+    if (headOnly_)
+    {
+        /* 缓存项的头部中已有 Content-length, 内容不再交给调用方 */
+        cached_.reset();
+    }
+}
+
+int HttpResponse::FileStatus_(const StaticCache::FileInfo &file)
+{
+    if (file.err == EACCES)
+    {
+        return 403;
+    }
+    if (file.err != 0 || S_ISDIR(file.st.st_mode))
+    {
+        return 404;
+    }
+    return file.st.st_mode & S_IROTH ? 200 : 403;
+}
+
+bool HttpResponse::IsWarm(string_view path, int code)
+{
+    StaticCache *cache = StaticCache::Instance();
+    if (code == -1)
+    {
+        StaticCache::FilePtr failed;
+        if (!cache->IsWarm(path, &failed))
+        {
+            return false;
+        }
+        if (!failed)
+        {
+            return true;
+        }
+        code = FileStatus_(*failed);
+    }
+    /* 错误页与普通文件一样, 须已缓存才不读文件; 没有错误页的状态码由 AddContent_ 生成简短页面 */
+    auto it = CODE_PATH.find(code);
+    return it == CODE_PATH.end() || cache->IsWarm(it->second);
 }
 
 char *HttpResponse::File()
 {
-    return mmFile_;
+    /* 缓存项只读, 这里仅为与映射统一交给 writev */
+    return cached_ ? const_cast<char *>(cached_->body.data()) : mmFile_;
+}
+
+char *HttpResponse::TakeFile()
+{
+    char *file = mmFile_;
+    mmFile_ = nullptr;
+    return file;
 }
 
 size_t HttpResponse::FileLen() const
 {
-    return mmFileStat_.st_size;
+    return cached_ ? cached_->body.size() : mmFileStat_.st_size;
+}
+
+void HttpResponse::SetAcceptEncoding(string_view value)
+{
+    /* 逐项解析 "coding[;param]...", 任一参数为 q=0 的视为不接受; "*" 代表全部 */
+    acceptEncoding_ = 0;
+    while (!value.empty())
+    {
+        size_t comma = value.find(',');
+        string_view item = value.substr(0, comma);
+        value = comma == string_view::npos ? string_view() : value.substr(comma + 1);
+        size_t semi = item.find(';');
+        string_view coding = Trim(item.substr(0, semi));
+        bool rejected = false;
+        while (semi != string_view::npos && !rejected)
+        {
+            /* 逐个检查 ';' 分隔的参数, 其他参数忽略; q 的取值为 0 至 1, 最多三位小数 */
+            item = item.substr(semi + 1);
+            semi = item.find(';');
+            string_view param = Trim(item.substr(0, semi));
+            rejected = param.size() >= 3 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=' &&
+                       param[2] == '0' && param.substr(3).find_first_not_of("0.") == string_view::npos;
+        }
+        if (rejected)
+        {
+            continue;
+        }
+        if (coding.size() == 2 && strncasecmp(coding.data(), "br", 2) == 0)
+        {
+            acceptEncoding_ |= 1u << StaticCache::BROTLI;
+        }
+        else if (coding.size() == 4 && strncasecmp(coding.data(), "gzip", 4) == 0)
+        {
+            acceptEncoding_ |= 1u << StaticCache::GZIP;
+        }
+        else if (coding == "*")
+        {
+            acceptEncoding_ |= (1u << StaticCache::ENCODING_NUM) - 1;
+        }
+    }
+}
+
+void HttpResponse::SetConditional(string_view ifNoneMatch, string_view ifModifiedSince)
+{
+    ifNoneMatch_ = ifNoneMatch;
+    ifModifiedSince_ = ifModifiedSince;
+}
+
+bool HttpResponse::NotModified_()
+{
+    /* 按 mmFileStat_ 中已取得的 stat 校验; 有 If-None-Match 时忽略 If-Modified-Since(RFC 7232 3.3) */
+    if (!ifNoneMatch_.empty())
+    {
+        return MatchETag_();
+    }
+    /* 只支持 IMF-fixdate 格式, 无法解析时按未命中处理 */
+    char date[64];
+    size_t len = std::min(ifModifiedSince_.size(), sizeof(date) - 1);
+    memcpy(date, ifModifiedSince_.data(), len);
+    date[len] = '\0';
+    struct tm tm = {};
+    const char *end = strptime(date, " %a, %d %b %Y %H:%M:%S GMT", &tm);
+    return end != nullptr && Trim(end).empty() && mmFileStat_.st_mtime <= timegm(&tm);
+}
+
+bool HttpResponse::MatchETag_()
+{
+    /* If-None-Match = "*" / #entity-tag, entity-tag = [W/] DQUOTE *etagc DQUOTE
+       按弱比较: 不论有无 W/ 前缀, 与原文件或客户端可接受的编码版本的 ETag 相同即可; 格式错误时按未命中处理 */
+    if (Trim(ifNoneMatch_) == "*")
+    {
+        return true;
+    }
+    char etags[StaticCache::ENCODING_NUM + 1][64];
+    size_t lens[StaticCache::ENCODING_NUM + 1] = {};
+    bool compressible = IsCompressible_(GetFileType_());
+    for (int encoding = -1; encoding < StaticCache::ENCODING_NUM; encoding++)
+    {
+        if (encoding < 0 || (compressible && (acceptEncoding_ & (1u << encoding))))
+        {
+            lens[encoding + 1] = StaticCache::FormatETag(mmFileStat_, encoding, etags[encoding + 1], sizeof(etags[0]));
+        }
+    }
+    string_view list = ifNoneMatch_;
+    while (true)
+    {
+        /* 列表允许空元素 */
+        while (!list.empty() && (list.front() == ',' || list.front() == ' ' || list.front() == '\t'))
+        {
+            list.remove_prefix(1);
+        }
+        if (list.empty())
+        {
+            return false;
+        }
+        if (list.substr(0, 2) == "W/")
+        {
+            list.remove_prefix(2);
+        }
+        size_t close = list.empty() || list.front() != '"' ? string_view::npos : list.find('"', 1);
+        if (close == string_view::npos)
+        {
+            return false;
+        }
+        string_view tag = list.substr(0, close + 1);
+        for (int i = 0; i <= StaticCache::ENCODING_NUM; i++)
+        {
+            if (lens[i] > 0 && tag == string_view(etags[i], lens[i]))
+            {
+                etagEncoding_ = i - 1;
+                return true;
+            }
+        }
+        list = Trim(list.substr(close + 1));
+        if (!list.empty() && list.front() != ',')
+        {
+            return false;
+        }
+    }
+}
+
+bool HttpResponse::IsCompressible_(string_view type)
+{
+    /* woff/woff2 与图片、视频已是压缩格式 */
+    return type.substr(0, 5) == "text/" || type == "application/xhtml+xml" || type == "application/rtf" ||
+           type == "image/svg+xml" || type == "font/ttf" || type == "font/otf" ||
+           type == "application/vnd.ms-fontobject";
+}
+
+void HttpResponse::Negotiate_()
+{
+    /* 可压缩的类型无论本次是否压缩都通告 Vary, 避免中间缓存把某一种编码发给所有客户端 */
+    string_view type = GetFileType_();
+    vary_ = IsCompressible_(type);
+    if (!vary_ || acceptEncoding_ == 0)
+    {
+        return;
+    }
+    /* 压缩版本来自旁文件或后台压缩的结果, 尚未就绪时本次发送原文件 */
+    for (StaticCache::ENCODING encoding : {StaticCache::BROTLI, StaticCache::GZIP})
+    {
+        if (!(acceptEncoding_ & (1u << encoding)))
+        {
+            continue;
+        }
+        StaticCache::EntryPtr entry = StaticCache::Instance()->GetEncoded(path_, encoding, type);
+        if (entry)
+        {
+            cached_ = std::move(entry);
+            file_.reset();
+            return;
+        }
+    }
 }
 
 void HttpResponse::ErrorHtml_()
@@ -107,23 +413,55 @@ void HttpResponse::ErrorHtml_()
     if (CODE_PATH.count(code_) == 1)
     {
         path_ = CODE_PATH.find(code_)->second;
-        stat((srcDir_ + path_).data(), &mmFileStat_);
+        cached_ = StaticCache::Instance()->Get(path_, GetFileType_());
+        if (!cached_)
+        {
+            file_ = StaticCache::Instance()->Open(srcDir_, path_);
+            mmFileStat_ = file_->st;
+        }
+    }
+    else if (code_ != 200 && code_ != 304)
+    {
+        /* 没有错误页的状态码, 由 AddContent_ 生成简短页面 */
+        path_ = string_view();
     }
 }
 
-void HttpResponse::AddStateLine_(Buffer &buff)
+void HttpResponse::AppendNum_(Buffer &buff, long num)
+{
+    char str[24];
+    int len = snprintf(str, sizeof(str), "%ld", num);
+    buff.Append(str, len);
+}
+
+void HttpResponse::AppendChunk(Buffer &buff, string_view data)
 {
-    string status;
-    if (CODE_STATUS.count(code_) == 1)
+    /* 长度为0的段会被当作结束块, 跳过 */
+    if (data.empty())
     {
-        status = CODE_STATUS.find(code_)->second;
+        return;
     }
-    else
+    char size[24];
+    int len = snprintf(size, sizeof(size), "%zx\r\n", data.size());
+    buff.Append(size, len);
+    buff.Append(data);
+    buff.Append("\r\n");
+}
+
+void HttpResponse::AppendLastChunk(Buffer &buff)
+{
+    buff.Append("0\r\n\r\n");
+}
+
+void HttpResponse::AddStateLine_(Buffer &buff)
+{
+    auto it = STATUS_LINE.find(code_);
+    if (it == STATUS_LINE.end())
     {
         code_ = 400;
-        status = CODE_STATUS.find(400)->second;
+        it = STATUS_LINE.find(400);
     }
-    buff.Append("HTTP/1.1 " + to_string(code_) + " " + status + "\r\n");
+    buff.Append(it->second);
 }
 
 void HttpResponse::AddHeader_(Buffer &buff)
@@ -132,36 +470,116 @@ void HttpResponse::AddHeader_(Buffer &buff)
     if (isKeepAlive_)
     {
         buff.Append("keep-alive\r\n");
-        buff.Append("keep-alive: max=6, timeout=120\r\n");
+        /* 通告值与服务器实际执行的限制一致 */
+        buff.Append("Keep-Alive: ");
+        if (keepAliveTimeout_ > 0)
+        {
+            buff.Append("timeout=");
+            AppendNum_(buff, keepAliveTimeout_);
+            buff.Append(", ");
+        }
+        buff.Append("max=");
+        AppendNum_(buff, keepAliveLeft_);
+        buff.Append("\r\n");
     }
     else
     {
         buff.Append("close\r\n");
     }
-    buff.Append("Content-type: " + GetFileType_() + "\r\n");
+    if (vary_)
+    {
+        buff.Append("Vary: Accept-Encoding\r\n");
+    }
+    if (code_ == 200 || code_ == 304)
+    {
+        AddValidators_(buff);
+    }
+    if (code_ == 304)
+    {
+        /* 304 不带内容, 也不发送 Content-length */
+        buff.Append("\r\n");
+        return;
+    }
+    if (cached_)
+    {
+        /* 缓存项中已有 Content-type(Content-Encoding) 与 Content-length */
+        buff.Append(cached_->head);
+        return;
+    }
+    string_view type = GetFileType_();
+    buff.Append("Content-type: ");
+    buff.Append(type);
+    buff.Append("\r\n");
+}
+
+void HttpResponse::AddValidators_(Buffer &buff)
+{
+    /* 缓存项中已有拼好的校验器 */
+    if (code_ == 200 && cached_)
+    {
+        buff.Append(cached_->validators);
+    }
+    else
+    {
+        char validators[StaticCache::VALIDATORS_MAX];
+        buff.Append(validators, StaticCache::FormatValidators(mmFileStat_, code_ == 304 ? etagEncoding_ : -1,
+                                                              validators, sizeof(validators)));
+    }
+    int maxAge = GetFileTypeInfo_().maxAge;
+    if (maxAge == 0)
+    {
+        buff.Append("Cache-Control: no-cache\r\n");
+    }
+    else if (maxAge > 0)
+    {
+        buff.Append("Cache-Control: max-age=");
+        AppendNum_(buff, maxAge);
+        buff.Append("\r\n");
+    }
 }
 
 void HttpResponse::AddContent_(Buffer &buff)
 {
-    int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
-    if (srcFd < 0)
+    if (cached_ || code_ == 304)
     {
-        ErrorContent(buff, "File NotFound!");
         return;
     }
-
-    /* 将文件映射到内存提高文件的访问速度
-        MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
-    LOG_DEBUG("file path %s", (srcDir_ + path_).data());
-    int *mmRet = (int *)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
-    if (*mmRet == -1)
+    if (path_.empty())
+    {
+        ErrorContent(buff, CODE_STATUS.find(code_)->second);
+        return;
+    }
+    if (!file_ || file_->fd < 0)
     {
         ErrorContent(buff, "File NotFound!");
         return;
     }
-    mmFile_ = (char *)mmRet;
-    close(srcFd);
-    buff.Append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
+    LOG_DEBUG("file path %.*s%.*s", (int)srcDir_.size(), srcDir_.data(), (int)path_.size(), path_.data());
+    if (headOnly_)
+    {
+        /* 只需文件大小 */
+        file_.reset();
+    }
+    else if (static_cast<size_t>(mmFileStat_.st_size) >= sendfileThreshold)
+    {
+        /* 大文件由 sendfile 从fd直接发送: 不缺页, 传输期间也不占用地址空间 */
+        sendfile_ = true;
+    }
+    else
+    {
+        /* 将文件映射到内存提高文件的访问速度
+            MAP_PRIVATE 建立一个写入时拷贝的私有映射*/
+        void *mmRet = mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, file_->fd, 0);
+        if (mmRet == MAP_FAILED)
+        {
+            ErrorContent(buff, "File NotFound!");
+            return;
+        }
+        mmFile_ = static_cast<char *>(mmRet);
+    }
+    buff.Append("Content-length: ");
+    AppendNum_(buff, mmFileStat_.st_size);
+    buff.Append("\r\n\r\n");
 }
 
 void HttpResponse::UnmapFile()
@@ -171,42 +589,81 @@ void HttpResponse::UnmapFile()
         munmap(mmFile_, mmFileStat_.st_size);
         mmFile_ = nullptr;
     }
+    cached_.reset();
+    file_.reset();
+    sendfile_ = false;
+}
+
+StaticCache::FilePtr HttpResponse::TakeSendFile()
+{
+    if (!sendfile_)
+    {
+        return nullptr;
+    }
+    sendfile_ = false;
+    return std::move(file_);
+}
+
+string_view HttpResponse::GetFileType_()
+{
+    return GetFileTypeInfo_().type;
 }
 
-string HttpResponse::GetFileType_()
+const HttpResponse::FileType &HttpResponse::GetFileTypeInfo_()
 {
-    /* 判断文件类型 */
-    string::size_type idx = path_.find_last_of('.');
-    if (idx == string::npos)
+    /* 按后缀判断文件类型 */
+    size_t idx = path_.find_last_of('.');
+    if (idx == string_view::npos)
     {
-        return "text/plain";
+        return DEFAULT_TYPE;
     }
-    string suffix = path_.substr(idx);
-    if (SUFFIX_TYPE.count(suffix) == 1)
+    auto it = SUFFIX_TYPE.find(path_.substr(idx));
+    if (it != SUFFIX_TYPE.end())
     {
-        return SUFFIX_TYPE.find(suffix)->second;
+        return it->second;
     }
-    return "text/plain";
+    return DEFAULT_TYPE;
 }
 
-void HttpResponse::ErrorContent(Buffer &buff, string message)
+void HttpResponse::ErrorContent(Buffer &buff, string_view message)
 {
-    string body;
-    string status;
-    body += "<html><title>Error</title>";
-    body += "<body bgcolor=\"ffffff\">";
-    if (CODE_STATUS.count(code_) == 1)
+    string_view status = "Bad Request";
+    auto it = CODE_STATUS.find(code_);
+    if (it != CODE_STATUS.end())
     {
-        status = CODE_STATUS.find(code_)->second;
+        status = it->second;
     }
-    else
+    if (chunked_)
     {
-        status = "Bad Request";
+        /* 边生成边写入, 无需先拼出整个页面来计算长度 */
+        buff.Append("Transfer-Encoding: chunked\r\n\r\n");
+        if (headOnly_)
+        {
+            return;
+        }
+        char head[128];
+        int len = snprintf(head, sizeof(head), "<html><title>Error</title><body bgcolor=\"ffffff\">%d : %.*s\n<p>",
+                           code_, (int)status.size(), status.data());
+        AppendChunk(buff, string_view(head, std::min(len, (int)sizeof(head) - 1)));
+        AppendChunk(buff, message);
+        AppendChunk(buff, "</p><hr><em>TinyWebServer</em></body></html>");
+        AppendLastChunk(buff);
+        return;
     }
-    body += to_string(code_) + " : " + status + "\n";
-    body += "<p>" + message + "</p>";
+    pmr::string body(arena_);
+    char code[24];
+    snprintf(code, sizeof(code), "%d", code_);
+    body += "<html><title>Error</title>";
+    body += "<body bgcolor=\"ffffff\">";
+    body.append(code).append(" : ").append(status).append("\n");
+    body.append("<p>").append(message).append("</p>");
     body += "<hr><em>TinyWebServer</em></body></html>";
 
-    buff.Append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
-    buff.Append(body);
+    buff.Append("Content-length: ");
+    AppendNum_(buff, body.size());
+    buff.Append("\r\n\r\n");
+    if (!headOnly_)
+    {
+        buff.Append(body);
+    }
 }
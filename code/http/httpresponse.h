@@ -7,6 +7,8 @@
 #define HTTP_RESPONSE_H
 
 #include <unordered_map>
+#include <string_view>
+#include <memory_resource>
 #include <fcntl.h>    // open
 #include <unistd.h>   // close
 #include <sys/stat.h> // stat
@@ -14,20 +16,53 @@
 
 #include "../buffer/buffer.h"
 #include "../log/log.h"
+#include "staticcache.h"
 
 class HttpResponse
 {
 public:
-    HttpResponse();
+    /* 生成响应时的临时字符串分配自 arena */
+    explicit HttpResponse(std::pmr::memory_resource *arena = std::pmr::get_default_resource());
     ~HttpResponse();
 
-    void Init(const std::string &srcDir, std::string &path, bool isKeepAlive = false, int code = -1);
+    /* srcDir 与 path 只保存视图, 不拷贝: 须在 MakeResponse 之前有效 */
+    void Init(std::string_view srcDir, std::string_view path, bool isKeepAlive = false, int code = -1);
     void MakeResponse(Buffer &buff);
     void UnmapFile();
+    /* 响应的文件内容: 缓存项或文件映射 */
     char *File();
+    /* 交出文件映射的所有权, 之后由调用方按 FileLen() 解除映射; 内容来自缓存时返回空 */
+    char *TakeFile();
+    /* 交出缓存项的引用, 发送完之前须一直持有 */
+    StaticCache::EntryPtr TakeCached() { return std::move(cached_); }
+    /* 大文件不映射, 交出打开的文件由调用方经其fd按偏移 sendfile 发送; 没有时返回空 */
+    StaticCache::FilePtr TakeSendFile();
+    bool IsSendFile() const { return sendfile_; }
     size_t FileLen() const;
-    void ErrorContent(Buffer &buff, std::string message);
+    void ErrorContent(Buffer &buff, std::string_view message);
     int Code() const { return code_; }
+    /* Keep-Alive 头中通告的空闲超时(秒, <=0不通告)与剩余可处理请求数 */
+    void SetKeepAliveParam(int timeoutSec, int maxLeft);
+    /* 客户端支持 chunked(HTTP/1.1)时, 长度事先未知的生成内容以 chunked 编码发送 */
+    void SetChunked(bool chunked) { chunked_ = chunked; }
+    /* HEAD 请求: 头部(含 Content-length)与 GET 相同, 不发送内容, 也不映射文件 */
+    void SetHeadOnly(bool headOnly) { headOnly_ = headOnly; }
+    /* 按请求的 Accept-Encoding 选择静态文件的内容编码(br 优先于 gzip) */
+    void SetAcceptEncoding(std::string_view value);
+    /* GET/HEAD 请求的 If-None-Match 与 If-Modified-Since, 校验通过时以不带内容的304响应
+       两者均为请求中的视图, 须在 MakeResponse 之前有效 */
+    void SetConditional(std::string_view ifNoneMatch, std::string_view ifModifiedSince);
+
+    /* chunked 编码: 每段为 "十六进制长度 CRLF 数据 CRLF", 以 "0 CRLF CRLF" 结束
+       头部以 "Transfer-Encoding: chunked" 代替 Content-length 后, 可在内容生成过程中逐段追加 */
+    static void AppendChunk(Buffer &buff, std::string_view data);
+    static void AppendLastChunk(Buffer &buff);
+
+    /* 生成 path 的响应是否无需文件I/O, 只查缓存: 内容已缓存, 或失败结果已缓存且对应的错误页也已缓存
+       code 为调用方已确定的错误状态(如400), -1时按 path 判断 */
+    static bool IsWarm(std::string_view path, int code = -1);
+
+    static size_t sendfileThreshold; /* 不小于该大小的文件以 sendfile 发送, 不再 mmap */
 
 private:
     void AddStateLine_(Buffer &buff);
@@ -35,19 +70,50 @@ private:
     void AddContent_(Buffer &buff);
 
     void ErrorHtml_();
-    std::string GetFileType_();
+    void Negotiate_();
+    bool NotModified_();
+    bool MatchETag_();
+    void AddValidators_(Buffer &buff);
+    std::string_view GetFileType_();
+    static bool IsCompressible_(std::string_view type);
+    /* 按打开结果确定状态码: 403/404, 或200 */
+    static int FileStatus_(const StaticCache::FileInfo &file);
 
+    static void AppendNum_(Buffer &buff, long num);
+
+    std::pmr::memory_resource *arena_;
     int code_;
     bool isKeepAlive_;
+    bool chunked_;
+    bool headOnly_;
+    unsigned acceptEncoding_; /* 可接受的 StaticCache::ENCODING, 按位 */
+    bool vary_;               /* 内容随 Accept-Encoding 变化, 须通告 Vary */
+    std::string_view ifNoneMatch_;
+    std::string_view ifModifiedSince_;
+    int etagEncoding_; /* 304响应中 ETag 对应的编码, -1为原文件 */
+    int keepAliveTimeout_;
+    int keepAliveLeft_;
 
-    std::string path_;
-    std::string srcDir_;
+    std::string_view path_;
+    std::string_view srcDir_;
 
     char *mmFile_;
     struct stat mmFileStat_;
+    StaticCache::EntryPtr cached_; /* 命中缓存时不再映射文件 */
+    StaticCache::FilePtr file_;    /* 已打开的文件与其 stat 结果 */
+    bool sendfile_;                /* file_ 以 sendfile 发送 */
+
+    struct FileType
+    {
+        std::string_view type;
+        int maxAge; /* Cache-Control 的 max-age(秒); 0 为 no-cache, 每次使用前须验证; 负数不发送 */
+    };
+    const FileType &GetFileTypeInfo_();
 
-    static const std::unordered_map<std::string, std::string> SUFFIX_TYPE;
+    static const FileType DEFAULT_TYPE;
+    static const std::unordered_map<std::string_view, FileType> SUFFIX_TYPE;
     static const std::unordered_map<int, std::string> CODE_STATUS;
+    static const std::unordered_map<int, std::string> STATUS_LINE; /* 预先拼好的状态行 */
     static const std::unordered_map<int, std::string> CODE_PATH;
 };
 
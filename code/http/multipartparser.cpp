@@ -0,0 +1,401 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-25
+ * @copyleft Apache 2.0
+ */
+#include "multipartparser.h"
+
+#include <string.h>
+#include <strings.h> // strncasecmp
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "../log/log.h"
+
+using std::string_view;
+
+namespace
+{
+    bool EqualsIgnoreCase(string_view a, string_view b)
+    {
+        return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+    }
+
+    string_view Trim(string_view v)
+    {
+        while (!v.empty() && (v.front() == ' ' || v.front() == '\t'))
+        {
+            v.remove_prefix(1);
+        }
+        while (!v.empty() && (v.back() == ' ' || v.back() == '\t'))
+        {
+            v.remove_suffix(1);
+        }
+        return v;
+    }
+
+    /* 从 "type; k1=v1; k2=\"v2\"" 形式的头部值中取参数 key, 去掉引号与反斜杠转义 */
+    bool GetParam(string_view value, string_view key, std::pmr::string &out)
+    {
+        size_t n = value.size();
+        size_t i = value.find(';');
+        while (i < n)
+        {
+            size_t eq = i + 1;
+            while (eq < n && value[eq] != '=' && value[eq] != ';')
+            {
+                eq++;
+            }
+            if (eq >= n || value[eq] == ';')
+            {
+                i = eq;
+                continue;
+            }
+            bool match = EqualsIgnoreCase(Trim(value.substr(i + 1, eq - i - 1)), key);
+            size_t v = eq + 1;
+            while (v < n && (value[v] == ' ' || value[v] == '\t'))
+            {
+                v++;
+            }
+            if (v < n && value[v] == '"')
+            {
+                out.clear();
+                for (v++; v < n && value[v] != '"'; v++)
+                {
+                    if (value[v] == '\\' && v + 1 < n)
+                    {
+                        v++;
+                    }
+                    if (match)
+                    {
+                        out.push_back(value[v]);
+                    }
+                }
+                i = value.find(';', v);
+            }
+            else
+            {
+                i = value.find(';', v);
+                if (match)
+                {
+                    out.assign(Trim(value.substr(v, i == string_view::npos ? n - v : i - v)));
+                }
+            }
+            if (match)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+MultipartParser::MultipartParser(std::pmr::memory_resource *arena, FieldMap *fields)
+    : arena_(arena), fields_(fields), files_(arena), line_(arena),
+      name_(arena), filename_(arena), contentType_(arena), value_(arena)
+{
+    Reset();
+}
+
+void MultipartParser::Reset()
+{
+    /* 字符串与空串交换而非赋值, 不保留 arena 中的缓冲区 */
+    files_ = FileList(arena_);
+    for (std::pmr::string *s : {&line_, &name_, &filename_, &contentType_, &value_})
+    {
+        std::pmr::string(arena_).swap(*s);
+    }
+    state_ = IDLE;
+    delimLen_ = holdLen_ = 0;
+    headerSize_ = 0;
+    isFile_ = false;
+    dataOff_ = dataLen_ = 0;
+}
+
+bool MultipartParser::Begin(string_view contentType)
+{
+    Reset();
+    string_view type = Trim(contentType.substr(0, contentType.find(';')));
+    std::pmr::string boundary(arena_);
+    if (!EqualsIgnoreCase(type, "multipart/form-data") || !GetParam(contentType, "boundary", boundary) ||
+        boundary.empty() || boundary.size() > MAX_BOUNDARY)
+    {
+        LOG_ERROR("Invalid multipart boundary");
+        return false;
+    }
+    memcpy(delim_, "\r\n--", 4);
+    memcpy(delim_ + 4, boundary.data(), boundary.size());
+    delimLen_ = boundary.size() + 4;
+    /* 第一个分隔符可位于请求体开头、前面没有CRLF: 预置CRLF, 使其与其余分隔符按同一规则匹配 */
+    memcpy(hold_, "\r\n", 2);
+    holdLen_ = 2;
+    state_ = PREAMBLE;
+    return true;
+}
+
+const char *MultipartParser::Search(const char *p, size_t len, const char *needle, size_t needleLen)
+{
+    if (needleLen == 0 || len < needleLen)
+    {
+        return nullptr;
+    }
+    const char *last = p + len - needleLen; /* 最后一个可能的起点 */
+#if defined(__SSE2__)
+    /* 首字节与末字节同时相等的位置才逐字节比较, 一次筛选16个起点 */
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i tail = _mm_set1_epi8(needle[needleLen - 1]);
+    for (; last - p >= 15; p += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + needleLen - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, tail)));
+        while (mask)
+        {
+            const char *hit = p + __builtin_ctz(mask);
+            if (memcmp(hit, needle, needleLen) == 0)
+            {
+                return hit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+    while (p <= last)
+    {
+        p = static_cast<const char *>(memchr(p, needle[0], last - p + 1));
+        if (p == nullptr)
+        {
+            return nullptr;
+        }
+        if (memcmp(p, needle, needleLen) == 0)
+        {
+            return p;
+        }
+        p++;
+    }
+    return nullptr;
+}
+
+void MultipartParser::OnBodyData(const char *p, size_t len, size_t offset)
+{
+    while (len > 0 && state_ != IDLE && state_ != END && state_ != ERROR)
+    {
+        size_t used = 1;
+        switch (state_)
+        {
+        case PREAMBLE:
+        case DATA:
+            used = ScanData_(p, len);
+            break;
+        case AFTER_DELIM:
+            /* 分隔符后允许有空白(transport-padding) */
+            if (*p == '-')
+            {
+                state_ = AFTER_DASH;
+            }
+            else if (*p == '\r')
+            {
+                state_ = AFTER_CR;
+            }
+            else if (*p != ' ' && *p != '\t')
+            {
+                Fail_("Invalid multipart delimiter");
+            }
+            break;
+        case AFTER_DASH:
+            if (*p == '-')
+            {
+                state_ = END;
+            }
+            else
+            {
+                Fail_("Invalid multipart close delimiter");
+            }
+            break;
+        case AFTER_CR:
+            if (*p != '\n')
+            {
+                Fail_("Invalid multipart delimiter");
+                break;
+            }
+            state_ = HEADERS;
+            headerSize_ = 0;
+            isFile_ = false;
+            line_.clear();
+            name_.clear();
+            filename_.clear();
+            contentType_.clear();
+            value_.clear();
+            break;
+        case HEADERS:
+        {
+            const char *lf = static_cast<const char *>(memchr(p, '\n', len));
+            used = lf ? lf - p + 1 : len;
+            headerSize_ += used;
+            if (headerSize_ > MAX_PART_HEADER)
+            {
+                Fail_("Multipart part header too large");
+                break;
+            }
+            line_.append(p, used);
+            if (lf == nullptr)
+            {
+                break;
+            }
+            string_view line(line_);
+            if (line.size() < 2 || line[line.size() - 2] != '\r')
+            {
+                Fail_("Invalid multipart header line");
+                break;
+            }
+            line.remove_suffix(2);
+            if (line.empty())
+            {
+                state_ = DATA;
+                dataOff_ = offset + used;
+                dataLen_ = 0;
+            }
+            else if (!ParsePartHeader_(line))
+            {
+                Fail_("Invalid multipart header");
+                break;
+            }
+            line_.clear();
+            break;
+        }
+        default:
+            break;
+        }
+        p += used;
+        len -= used;
+        offset += used;
+    }
+}
+
+size_t MultipartParser::ScanData_(const char *p, size_t len)
+{
+    /* 上一段末尾保留的字节可能是分隔符的开头, 与本段开头拼起来判定 */
+    if (holdLen_ > 0)
+    {
+        for (size_t i = 0; i < holdLen_; i++)
+        {
+            size_t held = holdLen_ - i;
+            size_t need = delimLen_ - held;
+            size_t cmp = std::min(need, len);
+            if (memcmp(hold_ + i, delim_, held) != 0 || memcmp(p, delim_ + held, cmp) != 0)
+            {
+                continue;
+            }
+            Emit_(hold_, i);
+            if (cmp < need)
+            {
+                /* 仍不足以判定, 继续保留 */
+                memmove(hold_, hold_ + i, held);
+                memcpy(hold_ + held, p, cmp);
+                holdLen_ = held + cmp;
+                return len;
+            }
+            holdLen_ = 0;
+            OnDelimiter_();
+            return need;
+        }
+        Emit_(hold_, holdLen_);
+        holdLen_ = 0;
+    }
+    const char *hit = Search(p, len, delim_, delimLen_);
+    if (hit)
+    {
+        Emit_(p, hit - p);
+        OnDelimiter_();
+        return hit - p + delimLen_;
+    }
+    /* 末尾不足一个分隔符长度且可能是其前缀的字节暂不输出 */
+    size_t keep = std::min(len, delimLen_ - 1);
+    while (keep > 0 && (p[len - keep] != '\r' || memcmp(p + len - keep, delim_, keep) != 0))
+    {
+        keep--;
+    }
+    Emit_(p, len - keep);
+    memcpy(hold_, p + len - keep, keep);
+    holdLen_ = keep;
+    return len;
+}
+
+void MultipartParser::Emit_(const char *p, size_t len)
+{
+    /* 文件部分只累计长度, 位置在进入 DATA 时已记下 */
+    if (state_ != DATA || len == 0)
+    {
+        return;
+    }
+    if (isFile_)
+    {
+        dataLen_ += len;
+        return;
+    }
+    if (value_.size() + len > MAX_FIELD_SIZE)
+    {
+        Fail_("Multipart field too large");
+        return;
+    }
+    value_.append(p, len);
+}
+
+void MultipartParser::OnDelimiter_()
+{
+    if (state_ == ERROR)
+    {
+        return;
+    }
+    if (state_ == DATA)
+    {
+        EndPart_();
+    }
+    state_ = AFTER_DELIM;
+}
+
+bool MultipartParser::ParsePartHeader_(string_view line)
+{
+    size_t colon = line.find(':');
+    if (colon == string_view::npos)
+    {
+        return false;
+    }
+    string_view key = Trim(line.substr(0, colon));
+    string_view value = Trim(line.substr(colon + 1));
+    if (EqualsIgnoreCase(key, "Content-Disposition"))
+    {
+        if (!EqualsIgnoreCase(Trim(value.substr(0, value.find(';'))), "form-data"))
+        {
+            return false;
+        }
+        GetParam(value, "name", name_);
+        isFile_ = GetParam(value, "filename", filename_);
+    }
+    else if (EqualsIgnoreCase(key, "Content-Type"))
+    {
+        contentType_.assign(value);
+    }
+    return true;
+}
+
+void MultipartParser::EndPart_()
+{
+    if (isFile_)
+    {
+        /* 显式指定 arena, 拷贝构造不会沿用原字符串的分配器 */
+        files_.push_back(FilePart{std::pmr::string(name_, arena_), std::pmr::string(filename_, arena_),
+                                  std::pmr::string(contentType_, arena_), dataOff_, dataLen_});
+        LOG_DEBUG("Multipart file %s: %s, %zu bytes", name_.c_str(), filename_.c_str(), dataLen_);
+    }
+    else if (!name_.empty())
+    {
+        (*fields_)[name_] = value_;
+    }
+}
+
+void MultipartParser::Fail_(const char *reason)
+{
+    LOG_ERROR("%s", reason);
+    state_ = ERROR;
+}
@@ -0,0 +1,98 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-25
+ * @copyleft Apache 2.0
+ */
+#ifndef MULTIPART_PARSER_H
+#define MULTIPART_PARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory_resource>
+#include "requestbody.h"
+
+/* multipart/form-data 的流式解析器, 作为 BodyListener 随请求体到达逐段解析, 不等待整个请求体
+   普通字段的值拷入 arena 写入字段表; 文件部分只记录其在请求体中的位置, 由处理方经
+   RequestBody::CopyTo 直接转存, 文件内容不在用户态再拷贝一次 */
+class MultipartParser : public BodyListener
+{
+public:
+    typedef std::pmr::unordered_map<std::pmr::string, std::pmr::string> FieldMap;
+
+    struct FilePart
+    {
+        std::pmr::string name;
+        std::pmr::string filename;
+        std::pmr::string contentType;
+        size_t offset; /* 文件内容在请求体中的起始位置 */
+        size_t length;
+    };
+    typedef std::pmr::vector<FilePart> FileList;
+
+    static const size_t MAX_BOUNDARY = 70;          /* RFC 2046 */
+    static const size_t MAX_PART_HEADER = 8192;     /* 单个部分的头部长度上限 */
+    static const size_t MAX_FIELD_SIZE = 64 * 1024; /* 普通字段值的长度上限 */
+
+    /* 解析出的普通字段写入 fields */
+    MultipartParser(std::pmr::memory_resource *arena, FieldMap *fields);
+
+    /* 以请求的 Content-Type 开始解析; 不是 multipart/form-data 或 boundary 非法时返回false */
+    bool Begin(std::string_view contentType);
+
+    /* 以空对象替换全部成员, 之后持有者才可重置 arena */
+    void Reset();
+
+    bool Active() const { return state_ != IDLE; }
+    /* 请求体结束时是否恰好解析到结束分隔符 */
+    bool Complete() const { return state_ == END; }
+
+    const FileList &Files() const { return files_; }
+
+    void OnBodyData(const char *data, size_t len, size_t offset) override;
+
+    /* 在 [p, p + len) 中查找 needle, SSE2 下按首尾字节整块筛选候选位置; 没有时返回nullptr */
+    static const char *Search(const char *p, size_t len, const char *needle, size_t needleLen);
+
+private:
+    enum STATE
+    {
+        IDLE,
+        PREAMBLE,    /* 第一个分隔符之前, 内容丢弃 */
+        AFTER_DELIM, /* 分隔符之后: "--" 结束, 或 CRLF 开始下一部分 */
+        AFTER_DASH,
+        AFTER_CR,
+        HEADERS,
+        DATA,
+        END,
+        ERROR,
+    };
+
+    size_t ScanData_(const char *p, size_t len);
+    void Emit_(const char *p, size_t len);
+    void OnDelimiter_();
+    bool ParsePartHeader_(std::string_view line);
+    void EndPart_();
+    void Fail_(const char *reason);
+
+    std::pmr::memory_resource *arena_;
+    FieldMap *fields_;
+    FileList files_;
+    STATE state_;
+
+    char delim_[MAX_BOUNDARY + 4]; /* "\r\n--" + boundary */
+    size_t delimLen_;
+    /* 上一段末尾可能是分隔符前缀的字节, 待下一段到达后判定 */
+    char hold_[MAX_BOUNDARY + 4];
+    size_t holdLen_;
+
+    /* 当前部分 */
+    std::pmr::string line_;
+    size_t headerSize_;
+    std::pmr::string name_, filename_, contentType_, value_;
+    bool isFile_;
+    size_t dataOff_, dataLen_;
+};
+
+#endif // MULTIPART_PARSER_H
@@ -0,0 +1,168 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-25
+ * @copyleft Apache 2.0
+ */
+#include "requestbody.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h> // mkstemp
+#include "../log/log.h"
+
+const char *RequestBody::tmpDir = "/tmp";
+
+RequestBody::RequestBody(std::pmr::memory_resource *arena)
+    : arena_(arena), listener_(nullptr), data_(arena), fd_(-1), size_(0)
+{
+}
+
+RequestBody::~RequestBody()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+    }
+}
+
+void RequestBody::Reset()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+    /* 与空串交换而非赋值: 移动赋值短串时会保留原有缓冲区, 而 arena 随后会被重置 */
+    std::pmr::string(arena_).swap(data_);
+    size_ = 0;
+    listener_ = nullptr;
+}
+
+bool RequestBody::Open(size_t expectLen)
+{
+    Reset();
+    if (expectLen <= MEMORY_LIMIT)
+    {
+        /* 一次预留, 避免 arena 中反复扩容留下的废弃副本 */
+        data_.reserve(expectLen);
+        return true;
+    }
+    return OpenFile_();
+}
+
+bool RequestBody::OpenFile_()
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/webserver-body-XXXXXX", tmpDir);
+    fd_ = mkstemp(path);
+    if (fd_ < 0)
+    {
+        LOG_ERROR("Create temp file for request body failed, errno:%d", errno);
+        return false;
+    }
+    /* 文件只经由fd访问, 关闭后内核自动回收 */
+    unlink(path);
+    return true;
+}
+
+bool RequestBody::Append(const char *data, size_t len)
+{
+    if (listener_)
+    {
+        listener_->OnBodyData(data, len, size_);
+    }
+    if (fd_ < 0 && size_ + len > MEMORY_LIMIT)
+    {
+        if (!OpenFile_() || !Write_(data_.data(), data_.size()))
+        {
+            return false;
+        }
+        std::pmr::string(arena_).swap(data_);
+    }
+    if (fd_ < 0)
+    {
+        data_.append(data, len);
+        size_ += len;
+        return true;
+    }
+    if (!Write_(data, len))
+    {
+        return false;
+    }
+    size_ += len;
+    return true;
+}
+
+bool RequestBody::Write_(const char *data, size_t len)
+{
+    if (!WriteAll_(fd_, data, len))
+    {
+        LOG_ERROR("Write request body to temp file failed, errno:%d", errno);
+        return false;
+    }
+    return true;
+}
+
+bool RequestBody::WriteAll_(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool RequestBody::CopyTo(int dstFd, size_t offset, size_t len) const
+{
+    if (offset > size_ || len > size_ - offset)
+    {
+        return false;
+    }
+    if (fd_ < 0)
+    {
+        return WriteAll_(dstFd, data_.data() + offset, len);
+    }
+    loff_t in = offset;
+    while (len > 0)
+    {
+        ssize_t n = copy_file_range(fd_, &in, dstFd, nullptr, len, 0);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        len -= n;
+    }
+    if (len == 0)
+    {
+        return true;
+    }
+    /* 内核不支持(如跨文件系统的旧内核)时退回读写拷贝 */
+    LOG_DEBUG("copy_file_range unavailable, errno:%d", errno);
+    char chunk[16 * 1024];
+    while (len > 0)
+    {
+        ssize_t n = pread(fd_, chunk, std::min(sizeof(chunk), len), in);
+        if (n <= 0 || !WriteAll_(dstFd, chunk, n))
+        {
+            LOG_ERROR("Copy request body failed, errno:%d", errno);
+            return false;
+        }
+        in += n;
+        len -= n;
+    }
+    return true;
+}
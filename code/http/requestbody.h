@@ -0,0 +1,101 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-25
+ * @copyleft Apache 2.0
+ */
+#ifndef REQUEST_BODY_H
+#define REQUEST_BODY_H
+
+#include <string>
+#include <string_view>
+#include <memory_resource>
+#include <algorithm>
+#include <unistd.h> // pread
+
+/* 请求体内容的流式消费者(如 multipart 解析器), 在数据写入的同时处理, 无需回读
+   offset 为该段在请求体中的起始位置 */
+class BodyListener
+{
+public:
+    virtual ~BodyListener() = default;
+    virtual void OnBodyData(const char *data, size_t len, size_t offset) = 0;
+};
+
+/* 请求体: 由解析器从读缓冲区逐段追加, 不要求整体连续
+   不超过 MEMORY_LIMIT 时存于 arena, 否则写入已 unlink 的临时文件, 请求结束时关闭
+   长度未知(chunked)时先存内存, 超出后连同已有内容一并转存
+   转存的 write 在解析线程上同步进行, inline 模式下即是Reactor线程: 写入通常只进页缓存, 不等待磁盘,
+   只在脏页回写受限时阻塞; 请求体总量受 maxBodySize 限制, 这一代价是可接受的 */
+class RequestBody
+{
+public:
+    static const size_t MEMORY_LIMIT = 64 * 1024;
+    static const char *tmpDir; /* 临时文件所在目录 */
+
+    explicit RequestBody(std::pmr::memory_resource *arena = std::pmr::get_default_resource());
+    ~RequestBody();
+
+    RequestBody(const RequestBody &) = delete;
+    RequestBody &operator=(const RequestBody &) = delete;
+
+    /* 按声明长度选择存放位置, 长度未知时传0; 无法创建临时文件时返回false */
+    bool Open(size_t expectLen);
+    bool Append(const char *data, size_t len);
+
+    /* 关闭临时文件并以空对象替换, 之后持有者才可重置 arena; 同时解除 listener */
+    void Reset();
+
+    /* 之后追加的每一段都同时交给 listener */
+    void SetListener(BodyListener *listener) { listener_ = listener; }
+
+    /* 把 [offset, offset + len) 写入 dstFd 的当前位置
+       存于临时文件时用 copy_file_range 在内核中完成, 不经用户态缓冲区 */
+    bool CopyTo(int dstFd, size_t offset, size_t len) const;
+
+    size_t Size() const { return size_; }
+    bool InMemory() const { return fd_ < 0; }
+    /* 仅 InMemory() 时有效 */
+    std::string_view Data() const { return data_; }
+    int Fd() const { return fd_; }
+
+    /* 依次回调请求体的各段; 临时文件中的内容分段读回, 不一次性载入内存 */
+    template <class F>
+    bool ForEachChunk(F &&f) const
+    {
+        if (fd_ < 0)
+        {
+            if (size_ > 0)
+            {
+                f(std::string_view(data_));
+            }
+            return true;
+        }
+        char chunk[16 * 1024];
+        size_t off = 0;
+        while (off < size_)
+        {
+            ssize_t n = pread(fd_, chunk, std::min(sizeof(chunk), size_ - off), off);
+            if (n <= 0)
+            {
+                return false;
+            }
+            f(std::string_view(chunk, n));
+            off += n;
+        }
+        return true;
+    }
+
+private:
+    bool OpenFile_();
+    bool Write_(const char *data, size_t len);
+
+    static bool WriteAll_(int fd, const char *data, size_t len);
+
+    std::pmr::memory_resource *arena_;
+    BodyListener *listener_;
+    std::pmr::string data_;
+    int fd_;
+    size_t size_;
+};
+
+#endif // REQUEST_BODY_H
@@ -0,0 +1,683 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-27
+ * @copyleft Apache 2.0
+ */
+#include "staticcache.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <limits.h> // PATH_MAX
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h> // openat2
+#include <zlib.h>
+#include <brotli/encode.h>
+#include "../log/log.h"
+
+using std::string;
+using std::string_view;
+
+namespace
+{
+    const uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                                IN_ONLYDIR;
+
+    /* 与 ENCODING 一一对应 */
+    const char *const ENCODING_NAME[] = {"gzip", "br"};
+    const char *const ENCODING_EXT[] = {".gz", ".br"};
+}
+
+size_t StaticCache::FormatETag(const struct stat &st, int encoding, char *buf, size_t size)
+{
+    /* 修改时间精确到纳秒, 同一秒内的改动也会改变 ETag */
+    unsigned long long mtime = st.st_mtim.tv_sec * 1000000000ull + st.st_mtim.tv_nsec;
+    int len = snprintf(buf, size, "\"%llx-%llx-%llx%s%s\"", (unsigned long long)st.st_ino,
+                       (unsigned long long)st.st_size, mtime, encoding >= 0 ? "-" : "",
+                       encoding >= 0 ? ENCODING_NAME[encoding] : "");
+    return len < 0 ? 0 : std::min(static_cast<size_t>(len), size - 1);
+}
+
+size_t StaticCache::FormatValidators(const struct stat &st, int encoding, char *buf, size_t size)
+{
+    /* Last-Modified 为 IMF-fixdate 格式的 GMT 时间 */
+    char etag[64], date[32];
+    FormatETag(st, encoding, etag, sizeof(etag));
+    struct tm tm;
+    gmtime_r(&st.st_mtime, &tm);
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    int len = snprintf(buf, size, "ETag: %s\r\nLast-Modified: %s\r\n", etag, date);
+    return len < 0 ? 0 : std::min(static_cast<size_t>(len), size - 1);
+}
+
+StaticCache *StaticCache::Instance()
+{
+    static StaticCache cache;
+    return &cache;
+}
+
+StaticCache::FileInfo::~FileInfo()
+{
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+StaticCache::StaticCache()
+    : rootFd_(-1), capacity_(0), gen_(0), hits_(0), misses_(0), evictions_(0), invalidations_(0),
+      fileHits_(0), fileMisses_(0), compressed_(0), inotifyFd_(-1), stopFd_(-1)
+{
+}
+
+StaticCache::~StaticCache()
+{
+    if (watchThread_)
+    {
+        uint64_t one = 1;
+        ssize_t ret = write(stopFd_, &one, sizeof(one));
+        (void)ret;
+        watchThread_->join();
+    }
+    /* 先释放缓存的fd, 再关闭 inotify */
+    entries_.Clear();
+    files_.Clear();
+    encoded_.Clear();
+    for (int fd : {inotifyFd_, stopFd_, rootFd_})
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+void StaticCache::Init(const char *srcDir, size_t capacity)
+{
+    assert(srcDir && inotifyFd_ < 0);
+    if (capacity == 0)
+    {
+        return;
+    }
+    srcDir_ = srcDir;
+    while (!srcDir_.empty() && srcDir_.back() == '/')
+    {
+        srcDir_.pop_back();
+    }
+    capacity_ = capacity;
+    /* 没有失效通知就无法保证内容最新, 此时不启用缓存; 无法排除符号链接(openat2)时同样 */
+    rootFd_ = open(srcDir_.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    FilePtr probe = rootFd_ >= 0 ? OpenFile_(string_view(), "/.", true) : nullptr;
+    if (!probe || probe->err == ENOSYS)
+    {
+        LOG_WARN("openat2 unavailable, static cache disabled");
+        return;
+    }
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_CLOEXEC);
+    if (inotifyFd_ < 0 || stopFd_ < 0)
+    {
+        LOG_WARN("inotify unavailable, static cache disabled, errno:%d", errno);
+        if (inotifyFd_ >= 0)
+        {
+            close(inotifyFd_);
+            inotifyFd_ = -1;
+        }
+        return;
+    }
+    AddWatch_("");
+    watchThread_.reset(new std::thread(&StaticCache::WatchLoop_, this));
+}
+
+bool StaticCache::Cacheable_(string_view path)
+{
+    /* 只缓存规范路径: 同一文件只对应一个键, 失效时才能按事件中的路径找到 */
+    if (path.size() < 2 || path[0] != '/' || path.back() == '/')
+    {
+        return false;
+    }
+    size_t i = 0;
+    while (i < path.size())
+    {
+        size_t next = path.find('/', i + 1);
+        string_view seg = path.substr(i + 1, next == string_view::npos ? string_view::npos : next - i - 1);
+        if (seg.empty() || seg == "." || seg == "..")
+        {
+            return false;
+        }
+        i = next;
+    }
+    return true;
+}
+
+StaticCache::EntryPtr StaticCache::Get(string_view path, string_view contentType)
+{
+    if (inotifyFd_ < 0 || !Cacheable_(path))
+    {
+        return nullptr;
+    }
+    uint64_t gen;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if (const EntryPtr *entry = entries_.Find(path))
+        {
+            hits_++;
+            return *entry;
+        }
+        misses_++;
+        gen = gen_;
+    }
+    /* 读文件时不持锁 */
+    EntryPtr entry = Load_(path, contentType);
+    if (!entry)
+    {
+        return nullptr;
+    }
+    size_t size = path.size() + entry->head.size() + entry->body.size() + sizeof(LruTable<EntryPtr>::Node);
+    if (size > capacity_)
+    {
+        return entry;
+    }
+    std::lock_guard<std::mutex> locker(mtx_);
+    if (gen != gen_)
+    {
+        /* 读入期间有文件改动, 内容可能已过期, 本次只用于当前响应 */
+        return entry;
+    }
+    entries_.Put(path, entry, size);
+    Evict_();
+    return entry;
+}
+
+StaticCache::EntryPtr StaticCache::Find(string_view path)
+{
+    if (inotifyFd_ < 0 || !Cacheable_(path))
+    {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> locker(mtx_);
+    if (const EntryPtr *entry = entries_.Find(path))
+    {
+        hits_++;
+        return *entry;
+    }
+    return nullptr;
+}
+
+bool StaticCache::IsWarm(string_view path, FilePtr *failed)
+{
+    if (inotifyFd_ < 0 || !Cacheable_(path))
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> locker(mtx_);
+    if (entries_.map.count(path) == 1)
+    {
+        return true;
+    }
+    auto it = files_.map.find(path);
+    if (it == files_.map.end() || it->second->value->fd >= 0)
+    {
+        return false;
+    }
+    if (failed)
+    {
+        *failed = it->second->value;
+    }
+    return true;
+}
+
+StaticCache::EntryPtr StaticCache::Load_(string_view path, string_view contentType)
+{
+    FilePtr file = OpenCached_(path);
+    string body;
+    if (file->fd < 0 || !(file->st.st_mode & S_IROTH) || static_cast<size_t>(file->st.st_size) > MAX_ENTRY_SIZE ||
+        !ReadAll_(*file, body))
+    {
+        return nullptr;
+    }
+    return MakeEntry_(contentType, -1, file->st, std::move(body));
+}
+
+bool StaticCache::ReadAll_(const FileInfo &file, string &out)
+{
+    out.resize(file.st.st_size);
+    size_t got = 0;
+    while (got < out.size())
+    {
+        /* fd 可能正被其他线程使用, 按偏移读取 */
+        ssize_t n = pread(file.fd, &out[got], out.size() - got, got);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        got += n;
+    }
+    /* 读取期间文件被截断时失败, 交给原流程处理 */
+    return got == out.size();
+}
+
+StaticCache::EntryPtr StaticCache::MakeEntry_(string_view contentType, int encoding, const struct stat &st,
+                                              string &&body)
+{
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->body = std::move(body);
+    entry->st = st;
+    char validators[VALIDATORS_MAX];
+    entry->validators.assign(validators, FormatValidators(st, encoding, validators, sizeof(validators)));
+    entry->head.reserve(contentType.size() + 96);
+    entry->head.append("Content-type: ").append(contentType).append("\r\n");
+    if (encoding >= 0)
+    {
+        entry->head.append("Content-Encoding: ").append(ENCODING_NAME[encoding]).append("\r\n");
+    }
+    entry->head.append("Content-length: ").append(std::to_string(entry->body.size())).append("\r\n\r\n");
+    return entry;
+}
+
+void StaticCache::Evict_()
+{
+    /* 响应缓存与压缩缓存共用字节上限, 从占用较多的一方淘汰 */
+    while (entries_.bytes + encoded_.bytes > capacity_)
+    {
+        (entries_.bytes >= encoded_.bytes ? entries_ : encoded_).PopBack();
+        evictions_++;
+    }
+}
+
+StaticCache::EntryPtr StaticCache::GetEncoded(string_view path, ENCODING encoding, string_view contentType)
+{
+    if (inotifyFd_ < 0 || !Cacheable_(path))
+    {
+        return nullptr;
+    }
+    /* 键在栈上拼接, 命中时不分配内存 */
+    char keyBuf[PATH_MAX];
+    size_t extLen = strlen(ENCODING_EXT[encoding]);
+    if (path.size() + extLen > sizeof(keyBuf))
+    {
+        return nullptr;
+    }
+    memcpy(keyBuf, path.data(), path.size());
+    memcpy(keyBuf + path.size(), ENCODING_EXT[encoding], extLen);
+    string_view key(keyBuf, path.size() + extLen);
+    uint64_t gen;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if (const EntryPtr *entry = encoded_.Find(key))
+        {
+            hits_++;
+            return (*entry)->head.empty() ? nullptr : *entry;
+        }
+        if (compressing_.count(string(key)))
+        {
+            return nullptr;
+        }
+        misses_++;
+        gen = gen_;
+    }
+    if (!executor_)
+    {
+        /* 未设置线程池时只在调用线程读入旁文件 */
+        EntryPtr entry = LoadSidecar_(path, key, encoding, contentType);
+        if (entry)
+        {
+            PutEncoded_(key, entry, gen);
+        }
+        return entry;
+    }
+    /* 读旁文件与压缩都在后台进行, 调用线程不做文件I/O */
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if (gen != gen_ || !compressing_.insert(string(key)).second)
+        {
+            return nullptr;
+        }
+    }
+    std::unique_ptr<CompressJob> job(new CompressJob{string(path), string(key), string(contentType), encoding, gen});
+    executor_(Task([this, job = std::move(job)]
+                   { Compress_(*job); }));
+    return nullptr;
+}
+
+void StaticCache::PutEncoded_(string_view key, EntryPtr entry, uint64_t gen)
+{
+    size_t size = key.size() + entry->head.size() + entry->body.size() + sizeof(LruTable<EntryPtr>::Node);
+    std::lock_guard<std::mutex> locker(mtx_);
+    compressing_.erase(string(key));
+    if (gen != gen_ || size > capacity_)
+    {
+        return;
+    }
+    encoded_.Put(key, std::move(entry), size);
+    Evict_();
+}
+
+StaticCache::EntryPtr StaticCache::LoadSidecar_(string_view path, string_view key, ENCODING encoding,
+                                                string_view contentType)
+{
+    /* 预先压缩好的旁文件; 校验器取自原文件 */
+    FilePtr file = OpenCached_(path);
+    FilePtr side = OpenCached_(key);
+    string body;
+    if (file->err != 0 || side->fd < 0 || !(side->st.st_mode & S_IROTH) ||
+        static_cast<size_t>(side->st.st_size) > MAX_ENTRY_SIZE || !ReadAll_(*side, body))
+    {
+        return nullptr;
+    }
+    return MakeEntry_(contentType, encoding, file->st, std::move(body));
+}
+
+void StaticCache::Compress_(const CompressJob &job)
+{
+    /* 在后台线程池中执行: 优先使用旁文件, 没有时压缩原文件; 读入期间文件有改动时 PutEncoded_ 丢弃结果 */
+    EntryPtr sidecar = LoadSidecar_(job.path, job.key, job.encoding, job.contentType);
+    if (sidecar)
+    {
+        PutEncoded_(job.key, std::move(sidecar), job.gen);
+        return;
+    }
+    FilePtr file = OpenCached_(job.path);
+    string src, out;
+    bool ok = file->fd >= 0 && (file->st.st_mode & S_IROTH) &&
+              static_cast<size_t>(file->st.st_size) <= MAX_COMPRESS_SIZE && ReadAll_(*file, src) &&
+              (job.encoding == GZIP ? Gzip_(src, out) : Brotli_(src, out));
+    EntryPtr entry;
+    if (ok && out.size() < src.size())
+    {
+        LOG_DEBUG("Compressed %s with %s: %zu -> %zu", job.path.c_str(), ENCODING_NAME[job.encoding], src.size(),
+                  out.size());
+        entry = MakeEntry_(job.contentType, job.encoding, file->st, std::move(out));
+    }
+    else
+    {
+        /* 记下不值得压缩, 之后直接发送原文件 */
+        entry = std::make_shared<Entry>();
+    }
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        compressed_++;
+    }
+    PutEncoded_(job.key, std::move(entry), job.gen);
+}
+
+bool StaticCache::Gzip_(const string &src, string &out)
+{
+    z_stream zs = {};
+    /* windowBits 加16输出gzip格式 */
+    if (deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+    out.resize(deflateBound(&zs, src.size()));
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(src.data()));
+    zs.avail_in = src.size();
+    zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    zs.avail_out = out.size();
+    int ret = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ret == Z_STREAM_END;
+}
+
+bool StaticCache::Brotli_(const string &src, string &out)
+{
+    size_t len = BrotliEncoderMaxCompressedSize(src.size());
+    if (len == 0)
+    {
+        return false;
+    }
+    out.resize(len);
+    if (!BrotliEncoderCompress(BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, src.size(),
+                               reinterpret_cast<const uint8_t *>(src.data()), &len,
+                               reinterpret_cast<uint8_t *>(&out[0])))
+    {
+        return false;
+    }
+    out.resize(len);
+    return true;
+}
+
+StaticCache::FilePtr StaticCache::Open(string_view srcDir, string_view path)
+{
+    if (inotifyFd_ >= 0 && Cacheable_(path))
+    {
+        return OpenCached_(path);
+    }
+    return OpenFile_(srcDir, path, false);
+}
+
+StaticCache::FilePtr StaticCache::OpenCached_(string_view path)
+{
+    uint64_t gen;
+    {
+        std::lock_guard<std::mutex> locker(mtx_);
+        if (const FilePtr *file = files_.Find(path))
+        {
+            fileHits_++;
+            return *file;
+        }
+        fileMisses_++;
+        gen = gen_;
+    }
+    FilePtr file = OpenFile_(string_view(), path, true);
+    if (file->err == ELOOP)
+    {
+        /* 路径中有符号链接, 其目标不在监视范围内: 不缓存 */
+        return OpenFile_(srcDir_, path, false);
+    }
+    std::lock_guard<std::mutex> locker(mtx_);
+    if (gen == gen_)
+    {
+        files_.Put(path, file, 1);
+        while (files_.map.size() > MAX_FILES)
+        {
+            files_.PopBack();
+        }
+    }
+    return file;
+}
+
+StaticCache::FilePtr StaticCache::OpenFile_(string_view dir, string_view path, bool cacheable)
+{
+    /* dir + path 在栈上拼成以NUL结尾的串; 缓存的文件相对 srcDir 打开, 去掉开头的'/' */
+    std::shared_ptr<FileInfo> file = std::make_shared<FileInfo>();
+    if (cacheable)
+    {
+        dir = string_view();
+        path.remove_prefix(1);
+    }
+    char name[PATH_MAX];
+    if (dir.size() + path.size() >= sizeof(name))
+    {
+        file->err = ENAMETOOLONG;
+        return file;
+    }
+    if (!dir.empty())
+    {
+        /* 缓存的文件 dir 为空视图, data() 可能为空指针, 不能传给 memcpy */
+        memcpy(name, dir.data(), dir.size());
+    }
+    memcpy(name + dir.size(), path.data(), path.size());
+    name[dir.size() + path.size()] = '\0';
+    /* O_NONBLOCK: 路径是FIFO时 open 不阻塞, 对普通文件无影响 */
+    int fd;
+    if (cacheable)
+    {
+        /* 相对 srcDir 解析且不经过任何符号链接, 保证文件的改动都在 inotify 监视范围内 */
+        struct open_how how = {};
+        how.flags = O_RDONLY | O_NONBLOCK | O_CLOEXEC;
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_SYMLINKS;
+        fd = syscall(SYS_openat2, rootFd_, name, &how, sizeof(how));
+    }
+    else
+    {
+        fd = open(name, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+    if (fd < 0)
+    {
+        file->err = errno;
+        return file;
+    }
+    if (fstat(fd, &file->st) < 0)
+    {
+        file->err = errno;
+        close(fd);
+        return file;
+    }
+    if (S_ISREG(file->st.st_mode))
+    {
+        file->fd = fd;
+    }
+    else
+    {
+        close(fd);
+    }
+    return file;
+}
+
+void StaticCache::Invalidate_(const string &path)
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    gen_++;
+    /* 文件本身或其旁文件改动, 都使对应的压缩项失效 */
+    invalidations_ += entries_.Erase(path) + files_.Erase(path) + encoded_.Erase(path);
+    for (const char *ext : ENCODING_EXT)
+    {
+        invalidations_ += encoded_.Erase(path + ext);
+    }
+}
+
+void StaticCache::Clear_()
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    gen_++;
+    invalidations_ += entries_.map.size() + files_.map.size() + encoded_.map.size();
+    entries_.Clear();
+    files_.Clear();
+    encoded_.Clear();
+}
+
+StaticCache::Stats StaticCache::GetStats()
+{
+    std::lock_guard<std::mutex> locker(mtx_);
+    return Stats{entries_.map.size(), entries_.bytes, hits_, misses_, evictions_, invalidations_,
+                 files_.map.size(), fileHits_, fileMisses_, encoded_.map.size(), compressed_};
+}
+
+void StaticCache::AddWatch_(const string &rel)
+{
+    string dir = srcDir_ + rel;
+    /* srcDir 本身可以是符号链接 */
+    int wd = inotify_add_watch(inotifyFd_, dir.c_str(), WATCH_MASK | (rel.empty() ? 0 : IN_DONT_FOLLOW));
+    if (wd < 0)
+    {
+        LOG_WARN("inotify watch %s failed, errno:%d", dir.c_str(), errno);
+        return;
+    }
+    watches_[wd] = rel;
+    /* inotify 不递归, 子目录逐个添加 */
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr)
+    {
+        return;
+    }
+    while (struct dirent *ent = readdir(d))
+    {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+        {
+            continue;
+        }
+        string sub = rel + "/" + ent->d_name;
+        struct stat st;
+        /* 部分文件系统不填 d_type; 符号链接指向的目录不监视 */
+        if (ent->d_type == DT_DIR ||
+            (ent->d_type == DT_UNKNOWN && lstat((srcDir_ + sub).c_str(), &st) == 0 && S_ISDIR(st.st_mode)))
+        {
+            AddWatch_(sub);
+        }
+    }
+    closedir(d);
+}
+
+void StaticCache::WatchLoop_()
+{
+    alignas(struct inotify_event) char buf[16 * 1024];
+    struct pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+        {
+            break;
+        }
+        if (fds[1].revents)
+        {
+            break;
+        }
+        ssize_t len;
+        while ((len = read(inotifyFd_, buf, sizeof(buf))) > 0)
+        {
+            for (char *p = buf; p < buf + len;)
+            {
+                struct inotify_event *ev = reinterpret_cast<struct inotify_event *>(p);
+                HandleEvent_(ev->wd, ev->mask, ev->len ? ev->name : "");
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+    }
+}
+
+void StaticCache::HandleEvent_(int wd, uint32_t mask, const char *name)
+{
+    if (mask & IN_Q_OVERFLOW)
+    {
+        /* 丢失了事件, 无法确定哪些项过期 */
+        LOG_WARN("inotify queue overflow, static cache cleared");
+        Clear_();
+        return;
+    }
+    if (mask & IN_IGNORED)
+    {
+        watches_.erase(wd);
+        return;
+    }
+    auto it = watches_.find(wd);
+    if (it == watches_.end())
+    {
+        return;
+    }
+    if (mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+    {
+        /* 目录本身被移走: 其新位置(若仍在 srcDir 下)由父目录的事件重新添加 */
+        inotify_rm_watch(inotifyFd_, wd);
+        Clear_();
+        return;
+    }
+    string rel = it->second + "/" + name;
+    if (mask & IN_ISDIR)
+    {
+        /* 目录的增删与改名影响其下所有路径, 很少发生, 直接清空 */
+        if (mask & (IN_CREATE | IN_MOVED_TO))
+        {
+            AddWatch_(rel);
+        }
+        Clear_();
+        return;
+    }
+    LOG_DEBUG("Static cache invalidate %s", rel.c_str());
+    Invalidate_(rel);
+}
@@ -0,0 +1,233 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-27
+ * @copyleft Apache 2.0
+ */
+#ifndef STATIC_CACHE_H
+#define STATIC_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <functional>
+#include <unordered_set>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <sys/stat.h>
+#include "../pool/task.h"
+
+/* 静态文件缓存, 所有线程共享, 以请求路径为键, 分三张表:
+   响应缓存: 文件内容与预先拼好的 Content-type/Content-length 头部, 命中时无需 stat/open/mmap, 按字节数设上限
+   打开文件缓存: 已打开的fd与 stat 结果, 以及不存在等失败结果, 命中时无需 open/fstat, 按项数设上限
+   压缩缓存: 文件的 gzip/brotli 编码, 取自 .gz/.br 旁文件或在后台线程池中压缩一次, 与响应缓存共用字节上限
+   各表都淘汰最久未使用的项; srcDir 下的改动经 inotify 通知后使对应项失效
+   取出的项以 shared_ptr 持有, 被淘汰或失效后仍可安全使用 */
+class StaticCache
+{
+public:
+    struct Entry
+    {
+        std::string head;       /* "Content-type: ..\r\nContent-length: ..\r\n\r\n" */
+        std::string validators; /* "ETag: ..\r\nLast-Modified: ..\r\n", 只用于200响应, 错误页不发送 */
+        std::string body;
+        struct stat st;         /* 原文件的 stat, 条件请求据此校验, 无需再 open/fstat */
+    };
+    typedef std::shared_ptr<const Entry> EntryPtr;
+
+    enum ENCODING
+    {
+        GZIP = 0,
+        BROTLI,
+        ENCODING_NUM,
+    };
+    /* 在后台线程池中执行任务 */
+    typedef std::function<void(Task &&)> Executor;
+
+    struct FileInfo
+    {
+        int err;         /* open 失败时的errno, 成功为0 */
+        struct stat st;  /* err 为0时有效 */
+        int fd;          /* 普通文件的只读fd, 随最后一个引用关闭; 多方共用, 只可按偏移读取 */
+
+        FileInfo() : err(0), st{}, fd(-1) {}
+        ~FileInfo();
+    };
+    typedef std::shared_ptr<const FileInfo> FilePtr;
+
+    struct Stats
+    {
+        size_t entries;
+        size_t bytes;
+        size_t hits;
+        size_t misses;
+        size_t evictions;
+        size_t invalidations; /* 因文件改动而删除的项 */
+        size_t files;         /* 打开文件缓存的项数 */
+        size_t fileHits;
+        size_t fileMisses;
+        size_t encoded;       /* 压缩缓存的项数 */
+        size_t compressed;    /* 后台完成的压缩次数 */
+    };
+
+    static const size_t MAX_ENTRY_SIZE = 256 * 1024;     /* 超过该大小的文件不缓存内容, 仍走 mmap/sendfile */
+    static const size_t MAX_FILES = 1024;                /* 打开文件缓存的项数上限, 也即最多占用的fd数 */
+    static const size_t MAX_COMPRESS_SIZE = 1024 * 1024; /* 超过该大小的文件不在后台压缩 */
+    static const int GZIP_LEVEL = 9;                     /* 每个文件只压缩一次, 取高压缩率 */
+    static const int BROTLI_QUALITY = 9;
+
+    static const size_t VALIDATORS_MAX = 128;
+
+    static StaticCache *Instance();
+
+    /* 强校验器 "inode-大小-修改时间(纳秒)", 十六进制, 含引号; encoding 非负时附加编码名, 与原文件的 ETag 区分
+       编码版本的校验器取自原文件: 旁文件须随原文件一同更新 */
+    static size_t FormatETag(const struct stat &st, int encoding, char *buf, size_t size);
+    /* "ETag: ..\r\nLast-Modified: ..\r\n", 写入不超过 VALIDATORS_MAX 字节 */
+    static size_t FormatValidators(const struct stat &st, int encoding, char *buf, size_t size);
+
+    /* capacity 为0或 inotify 不可用时缓存关闭: Get 总是返回空, Open 每次都打开文件 */
+    void Init(const char *srcDir, size_t capacity);
+
+    bool IsOpen() const { return inotifyFd_ >= 0; }
+
+    /* 取 path 的缓存项, 未命中时读入文件并缓存; 文件不存在、不可读或过大时返回空, 由调用方按原流程处理
+       contentType 只在读入文件时使用 */
+    EntryPtr Get(std::string_view path, std::string_view contentType);
+
+    /* 设置读旁文件与后台压缩使用的线程池; 未设置时只在调用线程读旁文件, 不压缩 */
+    void SetExecutor(Executor executor) { executor_ = std::move(executor); }
+
+    /* 取 path 以 encoding 编码的响应: 未缓存时提交后台任务, 有 .gz/.br 旁文件时读入, 否则压缩, 完成后缓存
+       尚未就绪、压缩后不更小或无法缓存时返回空, 由调用方发送原文件; 调用线程上从不读文件或压缩 */
+    EntryPtr GetEncoded(std::string_view path, ENCODING encoding, std::string_view contentType);
+
+    /* 只查响应缓存, 未命中时返回空, 不读文件 */
+    EntryPtr Find(std::string_view path);
+
+    /* path 的内容已缓存, 或打开文件缓存中记有失败结果(不存在、目录等, fd 为-1); 后者经 failed 取出
+       只查表, 不打开文件, 不计入命中统计 */
+    bool IsWarm(std::string_view path, FilePtr *failed = nullptr);
+
+    /* 打开 srcDir + path 并 fstat, 总是返回非空; 失败时 err 为 open 的 errno
+       缓存开启时 srcDir 须与 Init 时一致 */
+    FilePtr Open(std::string_view srcDir, std::string_view path);
+
+    Stats GetStats();
+
+private:
+    /* 以 string_view 为键的LRU表, 键指向节点中的字符串; 由外部加锁 */
+    template <typename T>
+    struct LruTable
+    {
+        struct Node
+        {
+            std::string key;
+            T value;
+            size_t size;
+        };
+        std::list<Node> lru; /* 表头为最近使用 */
+        std::unordered_map<std::string_view, typename std::list<Node>::iterator> map;
+        size_t bytes = 0;
+
+        const T *Find(std::string_view key)
+        {
+            auto it = map.find(key);
+            if (it == map.end())
+            {
+                return nullptr;
+            }
+            lru.splice(lru.begin(), lru, it->second);
+            return &it->second->value;
+        }
+
+        void Put(std::string_view key, T value, size_t size)
+        {
+            Erase(key);
+            lru.push_front(Node{std::string(key), std::move(value), size});
+            map.emplace(lru.front().key, lru.begin());
+            bytes += size;
+        }
+
+        bool Erase(std::string_view key)
+        {
+            auto it = map.find(key);
+            if (it == map.end())
+            {
+                return false;
+            }
+            bytes -= it->second->size;
+            auto node = it->second;
+            map.erase(it);
+            lru.erase(node);
+            return true;
+        }
+
+        void PopBack()
+        {
+            Erase(lru.back().key);
+        }
+
+        void Clear()
+        {
+            map.clear();
+            lru.clear();
+            bytes = 0;
+        }
+    };
+
+    StaticCache();
+    ~StaticCache();
+
+    struct CompressJob
+    {
+        std::string path, key, contentType;
+        ENCODING encoding;
+        uint64_t gen;
+    };
+
+    EntryPtr Load_(std::string_view path, std::string_view contentType);
+    static bool ReadAll_(const FileInfo &file, std::string &out);
+    static EntryPtr MakeEntry_(std::string_view contentType, int encoding, const struct stat &st, std::string &&body);
+    EntryPtr LoadSidecar_(std::string_view path, std::string_view key, ENCODING encoding,
+                          std::string_view contentType);
+    void PutEncoded_(std::string_view key, EntryPtr entry, uint64_t gen);
+    void Evict_();
+    void Compress_(const CompressJob &job);
+    static bool Gzip_(const std::string &src, std::string &out);
+    static bool Brotli_(const std::string &src, std::string &out);
+    FilePtr OpenCached_(std::string_view path);
+    /* 缓存的文件以 path 相对 rootFd_ 打开, dir 被忽略; 否则打开 dir + path */
+    FilePtr OpenFile_(std::string_view dir, std::string_view path, bool cacheable);
+    void Invalidate_(const std::string &path);
+    void Clear_();
+
+    static bool Cacheable_(std::string_view path);
+
+    /* inotify: 监视 srcDir 及其子目录, 由独立线程读取事件 */
+    void AddWatch_(const std::string &rel);
+    void WatchLoop_();
+    void HandleEvent_(int wd, uint32_t mask, const char *name);
+
+    std::string srcDir_; /* 不含末尾的'/' */
+    int rootFd_;         /* srcDir 的目录fd, 缓存的文件经它以不跟随符号链接的方式打开 */
+    size_t capacity_;
+
+    std::mutex mtx_;
+    LruTable<EntryPtr> entries_;
+    LruTable<FilePtr> files_;
+    LruTable<EntryPtr> encoded_; /* 键为 path 加 ".gz"/".br"; 值的 head 为空表示不值得压缩 */
+    std::unordered_set<std::string> compressing_; /* 已提交后台压缩的键 */
+    Executor executor_;
+    uint64_t gen_; /* 每次失效递增; 打开或读入文件期间发生过失效的, 不放入缓存 */
+    size_t hits_, misses_, evictions_, invalidations_;
+    size_t fileHits_, fileMisses_, compressed_;
+
+    int inotifyFd_;
+    int stopFd_;
+    std::unordered_map<int, std::string> watches_; /* wd -> 相对 srcDir 的目录, 根目录为"" */
+    std::unique_ptr<std::thread> watchThread_;
+};
+
+#endif // STATIC_CACHE_H
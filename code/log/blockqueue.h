@@ -37,6 +37,8 @@ public:
 
     void push_back(const T &item);
 
+    void push_back(T &&item);
+
     void push_front(const T &item);
 
     bool pop(T &item);
@@ -137,6 +139,18 @@ void BlockDeque<T>::push_back(const T &item)
     condConsumer_.notify_one();
 }
 
+template <class T>
+void BlockDeque<T>::push_back(T &&item)
+{
+    std::unique_lock<std::mutex> locker(mtx_);
+    while (deq_.size() >= capacity_)
+    {
+        condProducer_.wait(locker);
+    }
+    deq_.push_back(std::move(item));
+    condConsumer_.notify_one();
+}
+
 template <class T>
 void BlockDeque<T>::push_front(const T &item)
 {
@@ -175,7 +189,7 @@ bool BlockDeque<T>::pop(T &item)
             return false;
         }
     }
-    item = deq_.front();
+    item = std::move(deq_.front());
     deq_.pop_front();
     condProducer_.notify_one();
     return true;
@@ -196,7 +210,7 @@ bool BlockDeque<T>::pop(T &item, int timeout)
             return false;
         }
     }
-    item = deq_.front();
+    item = std::move(deq_.front());
     deq_.pop_front();
     condProducer_.notify_one();
     return true;
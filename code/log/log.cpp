@@ -141,6 +141,7 @@ void Log::write(int level, const char *format, ...)
     {
         unique_lock<mutex> locker(mtx_);
         lineCount_++;
+        buff_.EnsureWriteable(128);
         int n = snprintf(buff_.BeginWrite(), 128, "%d-%02d-%02d %02d:%02d:%02d.%06ld ",
                          t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
                          t.tm_hour, t.tm_min, t.tm_sec, now.tv_usec);
@@ -149,15 +150,33 @@ void Log::write(int level, const char *format, ...)
         AppendLogLevelTitle_(level);
 
         va_start(vaList, format);
-        int m = vsnprintf(buff_.BeginWrite(), buff_.WritableBytes(), format, vaList);
+        va_list vaCopy;
+        va_copy(vaCopy, vaList);
+        size_t writable = buff_.WritableBytes();
+        int m = vsnprintf(buff_.BeginWrite(), writable, format, vaList);
+        if (m >= 0 && static_cast<size_t>(m) >= writable)
+        {
+            /* 尾块放不下, 换一个足够大的块重新格式化 */
+            buff_.EnsureWriteable(m + 1);
+            m = vsnprintf(buff_.BeginWrite(), m + 1, format, vaCopy);
+        }
+        va_end(vaCopy);
         va_end(vaList);
 
-        buff_.HasWritten(m);
+        buff_.HasWritten(m > 0 ? m : 0);
         buff_.Append("\n\0", 2);
 
         if (isAsync_ && deque_ && !deque_->full())
         {
-            deque_->push_back(buff_.RetrieveAllToStr());
+            /* 复用写线程归还的字符串, 稳定运行后入队不再分配内存 */
+            string line;
+            if (!freeLines_.empty())
+            {
+                line = move(freeLines_.back());
+                freeLines_.pop_back();
+            }
+            line.assign(buff_.Peek(), buff_.ReadableBytes());
+            deque_->push_back(move(line));
         }
         else
         {
@@ -205,6 +224,10 @@ void Log::AsyncWrite_()
     {
         lock_guard<mutex> locker(mtx_);
         fputs(str.c_str(), fp_);
+        if (freeLines_.size() < MAX_FREE_LINES)
+        {
+            freeLines_.push_back(move(str));
+        }
     }
 }
 
@@ -8,6 +8,7 @@
 
 #include <mutex>
 #include <string>
+#include <vector>
 #include <thread>
 #include <sys/time.h>
 #include <string.h>
@@ -44,6 +45,7 @@ private:
     static const int LOG_PATH_LEN = 256;
     static const int LOG_NAME_LEN = 256;
     static const int MAX_LINES = 50000;
+    static const size_t MAX_FREE_LINES = 1024;
 
     const char *path_;
     const char *suffix_;
@@ -61,6 +63,7 @@ private:
 
     FILE *fp_;
     std::unique_ptr<BlockDeque<std::string>> deque_;
+    std::vector<std::string> freeLines_; /* 已写出的日志行, 留给下一次入队复用 */
     std::unique_ptr<std::thread> writeThread_;
     std::mutex mtx_;
 };
@@ -14,6 +14,8 @@ int main()
     WebServer server(
         1316, 3, 60000, false,                        /* 端口 ET模式 timeoutMs 优雅退出  */
         3306, "root", "TinyWebserver!2024", "yourdb", /* Mysql配置 */
-        12, 6, true, 1, 1024);                        /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        12, 6, true, 1, 1024,                         /* 连接池数量 线程池数量 日志开关 日志等级 日志异步队列容量 */
+        0, 0, false,                                  /* Reactor数量(0为单Reactor) IO后端(0:epoll 1:io_uring) inline模式 */
+        100, 4, 8 << 20, 32 << 20, 1 << 20);          /* 单连接Keep-Alive最大请求数 数据库通道线程数 请求体上限 静态响应缓存容量 sendfile阈值 */
     server.Start();
 }
@@ -0,0 +1,118 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-15
+ * @copyleft Apache 2.0
+ */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+#include <assert.h>
+
+/* 只可移动的 void() 任务, 可调用对象直接存放在内部固定大小的缓冲区中, 构造与移动都不分配堆内存
+   容量按 [this, reactor, client] 这类回调确定, 放不下的可调用对象在编译期报错 */
+class Task
+{
+public:
+    static const size_t CAPACITY = 48;
+
+    Task() noexcept : invoke_(nullptr), manage_(nullptr) {}
+
+    Task(std::nullptr_t) noexcept : Task() {}
+
+    template <class F, class Fn = typename std::decay<F>::type,
+              class = typename std::enable_if<!std::is_same<Fn, Task>::value>::type>
+    Task(F &&f)
+    {
+        static_assert(sizeof(Fn) <= CAPACITY, "callable too large for Task inline storage");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "callable over-aligned for Task");
+        new (&storage_) Fn(std::forward<F>(f));
+        invoke_ = [](void *self)
+        { (*static_cast<Fn *>(self))(); };
+        manage_ = [](void *dst, void *src)
+        {
+            /* dst非空时先移动到dst, 随后总是析构src */
+            if (dst)
+            {
+                new (dst) Fn(std::move(*static_cast<Fn *>(src)));
+            }
+            static_cast<Fn *>(src)->~Fn();
+        };
+    }
+
+    Task(Task &&other) noexcept : invoke_(other.invoke_), manage_(other.manage_)
+    {
+        if (manage_)
+        {
+            manage_(&storage_, &other.storage_);
+            other.invoke_ = nullptr;
+            other.manage_ = nullptr;
+        }
+    }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.manage_)
+            {
+                other.manage_(&storage_, &other.storage_);
+                invoke_ = other.invoke_;
+                manage_ = other.manage_;
+                other.invoke_ = nullptr;
+                other.manage_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task &operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task()
+    {
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        if (manage_)
+        {
+            manage_(nullptr, &storage_);
+            invoke_ = nullptr;
+            manage_ = nullptr;
+        }
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return invoke_ != nullptr;
+    }
+
+    void operator()()
+    {
+        assert(invoke_);
+        invoke_(&storage_);
+    }
+
+private:
+    typedef void (*Invoke)(void *);
+    typedef void (*Manage)(void *, void *);
+
+    typename std::aligned_storage<CAPACITY, alignof(std::max_align_t)>::type storage_;
+    Invoke invoke_;
+    Manage manage_;
+};
+
+#endif // TASK_H
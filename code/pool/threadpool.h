@@ -9,31 +9,39 @@
 
 #include <mutex>
 #include <condition_variable>
-#include <queue>
+#include <atomic>
+#include <vector>
 #include <thread>
 #include <functional>
+#include <chrono>
+#include <string>
+#include <assert.h>
+#include "workqueue.h"
+#include "task.h"
+
+/* 工作窃取线程池: 每个工作线程有自己的无锁队列, 外部提交进入有界注入队列
+   工作线程依次从本地队列、注入队列(批量搬运到本地)、其他线程的本地队列取任务
+   只有存在休眠线程时提交方才加锁唤醒; 任务以 Task 按值存放, 提交与调度不分配堆内存
+   每个线程池即一条具名执行通道, 统计排队深度与排队等待时间 */
 class ThreadPool
 {
 public:
-    explicit ThreadPool(size_t threadCount = 8) : pool_(std::make_shared<Pool>())
+    /* 统计窗口为上一次 GetStats() 至今 */
+    struct Stats
+    {
+        size_t depth;     /* 当前排队中的任务数 */
+        size_t executed;  /* 窗口内开始执行的任务数 */
+        double avgWaitMs; /* 窗口内平均排队时间 */
+        double maxWaitMs; /* 窗口内最大排队时间 */
+    };
+
+    explicit ThreadPool(size_t threadCount = 8, const std::string &name = "pool") : pool_(std::make_shared<Pool>(threadCount)), name_(name)
     {
         assert(threadCount > 0);
         for (size_t i = 0; i < threadCount; i++)
         {
-            std::thread([pool = pool_]
-                        {
-                    std::unique_lock<std::mutex> locker(pool->mtx);
-                    while(true) {
-                        if(!pool->tasks.empty()) {
-                            auto task = std::move(pool->tasks.front());
-                            pool->tasks.pop();
-                            locker.unlock();
-                            task();
-                            locker.lock();
-                        } 
-                        else if(pool->isClosed) break;
-                        else pool->cond.wait(locker);
-                    } })
+            std::thread([pool = pool_, i]
+                        { pool->Run(i); })
                 .detach();
         }
     }
@@ -57,22 +65,206 @@ public:
     template <class F>
     void AddTask(F &&task)
     {
-        {
-            std::lock_guard<std::mutex> locker(pool_->mtx);
-            pool_->tasks.emplace(std::forward<F>(task));
-        }
-        pool_->cond.notify_one();
+        pool_->Push(Task(std::forward<F>(task)));
+    }
+
+    const std::string &Name() const
+    {
+        return name_;
+    }
+
+    Stats GetStats()
+    {
+        Stats stats;
+        stats.depth = pool_->pending.load(std::memory_order_relaxed);
+        stats.executed = pool_->executed.exchange(0, std::memory_order_relaxed);
+        int64_t waitNs = pool_->waitNs.exchange(0, std::memory_order_relaxed);
+        int64_t maxWaitNs = pool_->maxWaitNs.exchange(0, std::memory_order_relaxed);
+        stats.avgWaitMs = stats.executed ? waitNs / 1e6 / stats.executed : 0;
+        stats.maxWaitMs = maxWaitNs / 1e6;
+        return stats;
     }
 
 private:
+    /* 队列元素: 任务及入队时刻 */
+    struct Job
+    {
+        Task task;
+        int64_t since = 0;
+    };
+
     struct Pool
     {
+        static const size_t INJECT_CAP = 1 << 14;
+        static const size_t LOCAL_CAP = 256;
+        static const size_t BATCH = 16; /* 从注入队列一次最多搬运的任务数 */
+        static const int SPIN = 64;     /* 休眠前的自旋轮数 */
+
+        explicit Pool(size_t threadCount) : isClosed(false), idle(0), pending(0), executed(0),
+                                            waitNs(0), maxWaitNs(0), inject(INJECT_CAP)
+        {
+            for (size_t i = 0; i < threadCount; i++)
+            {
+                locals.emplace_back(new WorkQueue<Job>(LOCAL_CAP));
+            }
+        }
+
+        static int64_t Now()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        /* 出队后执行并记录排队时间 */
+        void Execute(Job &job)
+        {
+            int64_t wait = Now() - job.since;
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            executed.fetch_add(1, std::memory_order_relaxed);
+            waitNs.fetch_add(wait, std::memory_order_relaxed);
+            int64_t max = maxWaitNs.load(std::memory_order_relaxed);
+            while (wait > max && !maxWaitNs.compare_exchange_weak(max, wait, std::memory_order_relaxed))
+            {
+            }
+            job.task();
+            job.task = nullptr;
+        }
+
+        /* 当前线程所属的线程池及其下标, 用于区分内部提交与外部提交 */
+        struct Worker
+        {
+            Pool *pool = nullptr;
+            size_t id = 0;
+        };
+
+        static Worker &Local()
+        {
+            static thread_local Worker worker;
+            return worker;
+        }
+
+        void Push(Task &&task)
+        {
+            Worker &self = Local();
+            Job job;
+            job.task = std::move(task);
+            job.since = Now();
+            pending.fetch_add(1, std::memory_order_relaxed);
+            if (self.pool != this || !locals[self.id]->push(std::move(job)))
+            {
+                while (!inject.push(std::move(job)))
+                {
+                    if (self.pool == this)
+                    {
+                        /* 工作线程自身提交且队列全满, 直接执行避免互相等待 */
+                        Execute(job);
+                        return;
+                    }
+                    std::this_thread::yield();
+                }
+            }
+            /* 与 Run 中 idle 自增后的屏障配对, 二者至少有一方能看到对方的写入 */
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (idle.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard<std::mutex> locker(mtx);
+                cond.notify_one();
+            }
+        }
+
+        bool Next(size_t id, Job &job)
+        {
+            if (locals[id]->pop(job))
+            {
+                return true;
+            }
+            if (inject.pop(job))
+            {
+                /* 顺带搬运一批到本地队列, 空闲线程可再从这里窃取 */
+                Job extra;
+                for (size_t i = 1; i < BATCH && inject.pop(extra); i++)
+                {
+                    if (!locals[id]->push(std::move(extra)))
+                    {
+                        Execute(extra);
+                    }
+                }
+                return true;
+            }
+            for (size_t k = 1; k < locals.size(); k++)
+            {
+                if (locals[(id + k) % locals.size()]->pop(job))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool HasWork() const
+        {
+            if (!inject.empty())
+            {
+                return true;
+            }
+            for (auto &local : locals)
+            {
+                if (!local->empty())
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Run(size_t id)
+        {
+            Local().pool = this;
+            Local().id = id;
+            Job job;
+            while (true)
+            {
+                bool found = Next(id, job);
+                for (int i = 0; !found && i < SPIN; i++)
+                {
+                    std::this_thread::yield();
+                    found = Next(id, job);
+                }
+                if (found)
+                {
+                    Execute(job);
+                    continue;
+                }
+                std::unique_lock<std::mutex> locker(mtx);
+                idle.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                while (!isClosed && !HasWork())
+                {
+                    cond.wait(locker);
+                }
+                idle.fetch_sub(1, std::memory_order_relaxed);
+                if (isClosed && !HasWork())
+                {
+                    break;
+                }
+            }
+            Local().pool = nullptr;
+        }
+
         std::mutex mtx;
         std::condition_variable cond;
         bool isClosed;
-        std::queue<std::function<void()>> tasks;
+        std::atomic<int> idle;
+        std::atomic<size_t> pending;
+        std::atomic<size_t> executed;
+        std::atomic<int64_t> waitNs;
+        std::atomic<int64_t> maxWaitNs;
+        WorkQueue<Job> inject;
+        std::vector<std::unique_ptr<WorkQueue<Job>>> locals;
     };
     std::shared_ptr<Pool> pool_;
+    std::string name_;
 };
 
-#endif // THREADPOOL_H
\ No newline at end of file
+#endif // THREADPOOL_H
@@ -36,6 +36,26 @@ bool Epoller::ModFd(int fd, uint32_t events)
     return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
 }
 
+bool Epoller::AddFd(int fd, uint32_t events, void *ptr)
+{
+    if (fd < 0)
+        return false;
+    epoll_event ev = {0};
+    ev.data.ptr = ptr;
+    ev.events = events;
+    return 0 == epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+}
+
+bool Epoller::ModFd(int fd, uint32_t events, void *ptr)
+{
+    if (fd < 0)
+        return false;
+    epoll_event ev = {0};
+    ev.data.ptr = ptr;
+    ev.events = events;
+    return 0 == epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+}
+
 bool Epoller::DelFd(int fd)
 {
     if (fd < 0)
@@ -59,4 +79,10 @@ uint32_t Epoller::GetEvents(size_t i) const
 {
     assert(i < events_.size() && i >= 0);
     return events_[i].events;
+}
+
+void *Epoller::GetEventPtr(size_t i) const
+{
+    assert(i < events_.size() && i >= 0);
+    return events_[i].data.ptr;
 }
\ No newline at end of file
@@ -24,6 +24,11 @@ public:
 
     bool ModFd(int fd, uint32_t events);
 
+    /* 将ptr存入epoll_event.data.ptr, 事件分发时直接取回, 无需按fd查找 */
+    bool AddFd(int fd, uint32_t events, void *ptr);
+
+    bool ModFd(int fd, uint32_t events, void *ptr);
+
     bool DelFd(int fd);
 
     int Wait(int timeoutMs = -1);
@@ -32,6 +37,8 @@ public:
 
     uint32_t GetEvents(size_t i) const;
 
+    void *GetEventPtr(size_t i) const;
+
 private:
     int epollFd_;
 
@@ -0,0 +1,285 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-15
+ * @copyleft Apache 2.0
+ */
+
+#include "uring.h"
+
+#include <string.h>     // memset
+#include <sys/socket.h> // SOCK_NONBLOCK
+
+IoUring::IoUring(unsigned entries, int maxEvent) : ringFd_(-1), ringPtr_(MAP_FAILED), ringSize_(0),
+                                                   sqes_((struct io_uring_sqe *)MAP_FAILED), sqesSize_(0),
+                                                   sqeTail_(0), bufRing_(nullptr), bufRingSize_(0),
+                                                   bufBase_(nullptr), bufCount_(0), bufSize_(0), bufTail_(0),
+                                                   events_(maxEvent)
+{
+    assert(entries > 0 && events_.size() > 0);
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    /* multishot 请求会持续产生CQE, CQ 取 SQ 的4倍 */
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 4;
+    int fd = syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0)
+    {
+        return;
+    }
+    const unsigned need = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+                          IORING_FEAT_FAST_POLL | IORING_FEAT_EXT_ARG;
+    if ((p.features & need) != need)
+    {
+        close(fd);
+        return;
+    }
+
+    size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ringSize_ = sqSize > cqSize ? sqSize : cqSize;
+    ringPtr_ = mmap(0, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    sqesSize_ = p.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = (struct io_uring_sqe *)mmap(0, sqesSize_, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ringPtr_ == MAP_FAILED || sqes_ == MAP_FAILED)
+    {
+        close(fd);
+        return;
+    }
+
+    char *ring = static_cast<char *>(ringPtr_);
+    sqHead_ = (unsigned *)(ring + p.sq_off.head);
+    sqTail_ = (unsigned *)(ring + p.sq_off.tail);
+    sqArray_ = (unsigned *)(ring + p.sq_off.array);
+    sqMask_ = *(unsigned *)(ring + p.sq_off.ring_mask);
+    sqEntries_ = p.sq_entries;
+    sqeTail_ = *sqTail_;
+
+    cqHead_ = (unsigned *)(ring + p.cq_off.head);
+    cqTail_ = (unsigned *)(ring + p.cq_off.tail);
+    cqMask_ = *(unsigned *)(ring + p.cq_off.ring_mask);
+    cqes_ = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+    ringFd_ = fd;
+}
+
+IoUring::~IoUring()
+{
+    if (ringFd_ >= 0)
+    {
+        close(ringFd_);
+    }
+    if (ringPtr_ != MAP_FAILED)
+    {
+        munmap(ringPtr_, ringSize_);
+    }
+    if (sqes_ != MAP_FAILED)
+    {
+        munmap(sqes_, sqesSize_);
+    }
+    if (bufRing_)
+    {
+        munmap(bufRing_, bufRingSize_);
+    }
+    delete[] bufBase_;
+}
+
+bool IoUring::InitBufRing(unsigned count, unsigned size)
+{
+    /* ring 长度须为2的幂, bid 为16位 */
+    assert(IsOpen() && count > 0 && count <= 32768 && (count & (count - 1)) == 0);
+    bufRingSize_ = count * sizeof(struct io_uring_buf);
+    void *ptr = mmap(0, bufRingSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+    {
+        return false;
+    }
+    bufRing_ = static_cast<struct io_uring_buf_ring *>(ptr);
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)bufRing_;
+    reg.ring_entries = count;
+    reg.bgid = 0;
+    if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        munmap(bufRing_, bufRingSize_);
+        bufRing_ = nullptr;
+        return false;
+    }
+
+    bufCount_ = count;
+    bufSize_ = size;
+    bufBase_ = new char[(size_t)count * size];
+    bufTail_ = 0;
+    for (unsigned i = 0; i < count; i++)
+    {
+        RecycleBuf(i);
+    }
+    return true;
+}
+
+char *IoUring::GetBuf(uint16_t bid) const
+{
+    assert(bid < bufCount_);
+    return bufBase_ + (size_t)bid * bufSize_;
+}
+
+void IoUring::RecycleBuf(uint16_t bid)
+{
+    /* 将缓冲区放回 ring 尾部, 发布新的 tail 后内核即可再次选用 */
+    assert(bid < bufCount_);
+    /* 头文件的柔性数组在C++下偏移不为0, 直接按 io_uring_buf 数组访问 */
+    struct io_uring_buf *buf = reinterpret_cast<struct io_uring_buf *>(bufRing_) + (bufTail_ & (bufCount_ - 1));
+    buf->addr = (uint64_t)GetBuf(bid);
+    buf->len = bufSize_;
+    buf->bid = bid;
+    bufTail_++;
+    __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+}
+
+struct io_uring_sqe *IoUring::GetSqe_()
+{
+    if (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+    {
+        /* SQ 已满, 先提交一批 */
+        Submit();
+    }
+    unsigned idx = sqeTail_ & sqMask_;
+    struct io_uring_sqe *sqe = &sqes_[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray_[idx] = idx;
+    sqeTail_++;
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+void IoUring::PrepAccept(int fd, uint64_t data)
+{
+    /* multishot accept: 一个SQE持续接收新连接, 直到CQE不再带 IORING_CQE_F_MORE */
+    struct io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = data;
+}
+
+void IoUring::PrepRecv(int fd, uint64_t data)
+{
+    /* multishot recv + provided buffer: 数据到达时才占用缓冲区 */
+    assert(bufRing_);
+    struct io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = data;
+}
+
+void IoUring::PrepWritev(int fd, const struct iovec *iov, int iovCnt, uint64_t data)
+{
+    struct io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)iov;
+    sqe->len = iovCnt;
+    sqe->user_data = data;
+}
+
+void IoUring::PrepRead(int fd, void *buf, unsigned len, uint64_t data)
+{
+    struct io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)buf;
+    sqe->len = len;
+    sqe->user_data = data;
+}
+
+void IoUring::PrepCancelFd(int fd, uint64_t data)
+{
+    struct io_uring_sqe *sqe = GetSqe_();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = data;
+}
+
+int IoUring::Enter_(unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize)
+{
+    int ret;
+    do
+    {
+        ret = syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete, flags, arg, argSize);
+    } while (ret < 0 && errno == EINTR && minComplete == 0);
+    return ret;
+}
+
+int IoUring::Submit()
+{
+    unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if (toSubmit == 0)
+    {
+        return 0;
+    }
+    return Enter_(toSubmit, 0, 0, nullptr, _NSIG / 8);
+}
+
+int IoUring::Wait(int timeoutMs)
+{
+    unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    bool ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_;
+    if (ready)
+    {
+        /* 已有完成事件, 只提交不等待 */
+        if (toSubmit > 0)
+        {
+            Enter_(toSubmit, 0, 0, nullptr, _NSIG / 8);
+        }
+    }
+    else if (timeoutMs < 0)
+    {
+        Enter_(toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, _NSIG / 8);
+    }
+    else
+    {
+        struct __kernel_timespec ts;
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (long long)(timeoutMs % 1000) * 1000000;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)&ts;
+        Enter_(toSubmit, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+
+    /* 收割完成事件 */
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    int cnt = 0;
+    while (head != tail && cnt < static_cast<int>(events_.size()))
+    {
+        events_[cnt++] = cqes_[head & cqMask_];
+        head++;
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    return cnt;
+}
+
+uint64_t IoUring::GetData(size_t i) const
+{
+    assert(i < events_.size() && i >= 0);
+    return events_[i].user_data;
+}
+
+int IoUring::GetRes(size_t i) const
+{
+    assert(i < events_.size() && i >= 0);
+    return events_[i].res;
+}
+
+uint32_t IoUring::GetFlags(size_t i) const
+{
+    assert(i < events_.size() && i >= 0);
+    return events_[i].flags;
+}
@@ -0,0 +1,93 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-15
+ * @copyleft Apache 2.0
+ */
+#ifndef URING_H
+#define URING_H
+
+#include <linux/io_uring.h> // io_uring_sqe, io_uring_cqe
+#include <sys/syscall.h>    // __NR_io_uring_*
+#include <sys/mman.h>       // mmap()
+#include <sys/uio.h>        // iovec
+#include <unistd.h>         // close()
+#include <assert.h>
+#include <signal.h> // _NSIG
+#include <stdint.h>
+#include <vector>
+#include <errno.h>
+
+/* 基于原始系统调用的 io_uring 封装, 接口与 Epoller 对应:
+   Prep* 只填写SQE, Wait 一次系统调用提交本轮全部SQE并收割完成事件 */
+class IoUring
+{
+public:
+    explicit IoUring(unsigned entries = 1024, int maxEvent = 1024);
+
+    ~IoUring();
+
+    /* 内核不支持所需特性时返回false, 调用方应退回epoll */
+    bool IsOpen() const { return ringFd_ >= 0; }
+
+    /* 注册 provided buffer ring: recv 完成时由内核挑选缓冲区 */
+    bool InitBufRing(unsigned count, unsigned size);
+
+    char *GetBuf(uint16_t bid) const;
+
+    void RecycleBuf(uint16_t bid);
+
+    void PrepAccept(int fd, uint64_t data);
+
+    void PrepRecv(int fd, uint64_t data);
+
+    void PrepWritev(int fd, const struct iovec *iov, int iovCnt, uint64_t data);
+
+    void PrepRead(int fd, void *buf, unsigned len, uint64_t data);
+
+    void PrepCancelFd(int fd, uint64_t data);
+
+    int Submit();
+
+    int Wait(int timeoutMs = -1);
+
+    uint64_t GetData(size_t i) const;
+
+    int GetRes(size_t i) const;
+
+    uint32_t GetFlags(size_t i) const;
+
+private:
+    struct io_uring_sqe *GetSqe_();
+
+    int Enter_(unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize);
+
+    int ringFd_;
+
+    void *ringPtr_;
+    size_t ringSize_;
+    struct io_uring_sqe *sqes_;
+    size_t sqesSize_;
+
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned *sqArray_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned sqeTail_; /* 本地已填写但尚未发布的SQE尾 */
+
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe *cqes_;
+
+    struct io_uring_buf_ring *bufRing_;
+    size_t bufRingSize_;
+    char *bufBase_;
+    unsigned bufCount_;
+    unsigned bufSize_;
+    unsigned short bufTail_;
+
+    std::vector<struct io_uring_cqe> events_;
+};
+
+#endif // URING_H
@@ -12,20 +12,85 @@ WebServer::WebServer(
     int port, int trigMode, int timeoutMS, bool OptLinger,
     int sqlPort, const char *sqlUser, const char *sqlPwd,
     const char *dbName, int connPoolNum, int threadNum,
-    bool openLog, int logLevel, int logQueSize) : port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
-                                                  timer_(new HeapTimer()), threadpool_(new ThreadPool(threadNum)), epoller_(new Epoller())
+    bool openLog, int logLevel, int logQueSize,
+    int reactorNum, int ioBackend, bool inlineMode,
+    int keepAliveMax, int dbThreadNum, size_t maxBodySize, size_t staticCacheSize,
+    size_t sendfileThreshold) : port_(port), openLinger_(OptLinger), timeoutMS_(timeoutMS), isClose_(false),
+                                                      reusePort_(reactorNum > 0),
+                                                      inlineMode_(inlineMode || reactorNum > 0 || ioBackend == 1),
+                                                      threadpool_(new ThreadPool(threadNum, "io")),
+                                                      dbpool_(new ThreadPool(dbThreadNum, "db")),
+                                                      lastReport_(Clock::now()),
+                                                      users_(static_cast<HttpConn *>(::operator new(sizeof(HttpConn) * MAX_FD))),
+                                                      usersInit_(new bool[MAX_FD]()),
+                                                      owners_(new std::atomic<Reactor *>[MAX_FD]())
 {
     srcDir_ = getcwd(nullptr, 256);
     assert(srcDir_);
     strncat(srcDir_, "/resources/", 16);
     HttpConn::userCount = 0;
     HttpConn::srcDir = srcDir_;
+    /* 空闲超时由定时器执行, 这里只决定响应头中通告的值 */
+    assert(keepAliveMax > 0);
+    HttpConn::keepAliveMax = keepAliveMax;
+    HttpConn::keepAliveTimeout = timeoutMS > 0 ? timeoutMS / 1000 : 0;
+    HttpRequest::maxBodySize = maxBodySize;
+    bool uploadDirOk = mkdir(HttpRequest::uploadDir, 0755) == 0 || errno == EEXIST;
+    HttpResponse::sendfileThreshold = sendfileThreshold;
     SqlConnPool::Instance()->Init("localhost", sqlPort, sqlUser, sqlPwd, dbName, connPoolNum);
 
+    /* reactorNum <= 0: 单Reactor + 线程池; 否则每个Reactor线程独立处理自己的连接
+       非inline模式下所有请求交给线程池; inline模式下线程池只处理可能阻塞的请求 */
+    for (int i = 0; i < (reusePort_ ? reactorNum : 1); i++)
+    {
+        reactors_.emplace_back(new Reactor());
+    }
+
     InitEventMode_(trigMode);
-    if (!InitSocket_())
+    for (auto &reactor : reactors_)
     {
-        isClose_ = true;
+        reactor->epoller.reset(new Epoller());
+        /* 按fd索引的时间轮, 回调只在本Reactor线程触发
+           连接关闭后fd可能被其他Reactor复用, 此时本Reactor上残留的定时器不再生效 */
+        Reactor *r = reactor.get();
+        reactor->timer.reset(new TimeWheel([this, r](int fd) {
+            if (owners_[fd].load(std::memory_order_relaxed) == r)
+            {
+                CloseConn_(r, GetConn_(fd));
+            }
+        }));
+        if (ioBackend == 1)
+        {
+            /* 内核不支持时退回epoll */
+            reactor->uring.reset(new IoUring());
+            if (reactor->uring->IsOpen() && reactor->uring->InitBufRing(URING_BUF_COUNT, URING_BUF_SIZE))
+            {
+                /* 没有 eventfd 线程池就无法交还请求, 同样退回epoll */
+                reactor->wakeFd = eventfd(0, EFD_CLOEXEC);
+            }
+            if (reactor->wakeFd < 0)
+            {
+                reactor->uring.reset();
+            }
+            else
+            {
+                reactor->slots.reset(new UringSlot[MAX_FD]);
+            }
+        }
+        if (!InitSocket_(reactor.get()))
+        {
+            isClose_ = true;
+            break;
+        }
+    }
+
+    for (auto &reactor : reactors_)
+    {
+        if (reactor->uring)
+        {
+            /* io_uring 后端只提交 writev, 大文件仍用 mmap */
+            HttpResponse::sendfileThreshold = SIZE_MAX;
+        }
     }
 
     if (openLog)
@@ -42,21 +107,98 @@ WebServer::WebServer(
             LOG_INFO("Listen Mode: %s, OpenConn Mode: %s",
                      (listenEvent_ & EPOLLET ? "ET" : "LT"),
                      (connEvent_ & EPOLLET ? "ET" : "LT"));
+            LOG_INFO("IO backend: %s", reactors_[0]->uring ? "io_uring" : "epoll");
+            if (ioBackend == 1 && !reactors_[0]->uring)
+            {
+                LOG_WARN("io_uring unavailable, fall back to epoll");
+            }
             LOG_INFO("LogSys level: %d", logLevel);
             LOG_INFO("srcDir: %s", HttpConn::srcDir);
-            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d", connPoolNum, threadNum);
+            LOG_INFO("SqlConnPool num: %d, ThreadPool num: %d, DB lane num: %d", connPoolNum, threadNum, dbThreadNum);
+            LOG_INFO("Reactor num: %d, Inline mode: %s", (int)reactors_.size(), inlineMode_ ? "true" : "false");
+            LOG_INFO("Keep-Alive max: %d, timeout: %ds", HttpConn::keepAliveMax, HttpConn::keepAliveTimeout);
+            if (HttpResponse::sendfileThreshold != SIZE_MAX)
+            {
+                LOG_INFO("Sendfile for files over %zuKB, %zuKB per call", HttpResponse::sendfileThreshold / 1024,
+                         HttpConn::SENDFILE_CHUNK / 1024);
+            }
+            LOG_INFO("Max request body: %zuKB, spill to %s over %zuKB", HttpRequest::maxBodySize / 1024,
+                     RequestBody::tmpDir, RequestBody::MEMORY_LIMIT / 1024);
+            if (uploadDirOk)
+            {
+                LOG_INFO("Upload dir: %s", HttpRequest::uploadDir);
+            }
+            else
+            {
+                LOG_WARN("Create upload dir %s failed, uploads will fail", HttpRequest::uploadDir);
+            }
         }
     }
+    /* 在日志之后初始化, inotify 不可用的警告才能记录下来 */
+    StaticCache::Instance()->Init(srcDir_, staticCacheSize);
+    /* 压缩只在 io 线程池中进行, 不占用Reactor线程 */
+    StaticCache::Instance()->SetExecutor([this](Task &&task)
+                                         { threadpool_->AddTask(std::move(task)); });
+    if (openLog && !isClose_)
+    {
+        LOG_INFO("Static cache: %s, capacity:%zuKB, max entry:%zuKB", StaticCache::Instance()->IsOpen() ? "on" : "off",
+                 staticCacheSize / 1024, StaticCache::MAX_ENTRY_SIZE / 1024);
+    }
 }
 
 WebServer::~WebServer()
 {
-    close(listenFd_);
+    CloseAllConn_();
+    StaticCache::Instance()->SetExecutor(nullptr);
+    for (auto &reactor : reactors_)
+    {
+        if (reactor->listenFd >= 0)
+        {
+            close(reactor->listenFd);
+        }
+        if (reactor->wakeFd >= 0)
+        {
+            close(reactor->wakeFd);
+        }
+    }
     isClose_ = true;
     free(srcDir_);
     SqlConnPool::Instance()->ClosePool();
 }
 
+HttpConn *WebServer::GetConn_(int fd)
+{
+    assert(fd >= 0 && fd < MAX_FD);
+    if (!usersInit_[fd])
+    {
+        new (&users_[fd]) HttpConn();
+        usersInit_[fd] = true;
+    }
+    return &users_[fd];
+}
+
+void WebServer::CloseAllConn_()
+{
+    /* 顺序遍历连接槽, 关闭仍在线的连接并析构已构造的槽位 */
+    int closed = 0;
+    for (int fd = 0; fd < MAX_FD; fd++)
+    {
+        if (!usersInit_[fd])
+        {
+            continue;
+        }
+        if (users_[fd].GetFd() >= 0 && !users_[fd].IsClosed())
+        {
+            closed++;
+        }
+        users_[fd].~HttpConn();
+        usersInit_[fd] = false;
+    }
+    ::operator delete(users_);
+    users_ = nullptr;
+    LOG_INFO("Close %d connections on shutdown", closed);
+}
+
 void WebServer::InitEventMode_(int trigMode)
 {
     listenEvent_ = EPOLLRDHUP;
@@ -85,41 +227,62 @@ void WebServer::InitEventMode_(int trigMode)
 
 void WebServer::Start()
 {
-    int timeMS = -1; /* epoll wait timeout == -1 无事件将阻塞 */
     if (!isClose_)
     {
         LOG_INFO("========== Server start ==========");
     }
+    /* 其余Reactor各占一个线程, 第一个Reactor在当前线程运行 */
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < reactors_.size(); i++)
+    {
+        threads.emplace_back(&WebServer::Loop_, this, reactors_[i].get());
+    }
+    Loop_(reactors_[0].get());
+    for (auto &t : threads)
+    {
+        t.join();
+    }
+}
+
+void WebServer::Loop_(Reactor *reactor)
+{
+    if (reactor->uring)
+    {
+        LoopUring_(reactor);
+        return;
+    }
+    int timeMS = -1; /* epoll wait timeout == -1 无事件将阻塞 */
     while (!isClose_)
     {
+        if (reactor == reactors_[0].get())
+        {
+            ReportLanes_();
+        }
         if (timeoutMS_ > 0)
         {
-            timeMS = timer_->GetNextTick();
+            timeMS = reactor->timer->GetNextTick();
         }
-        int eventCnt = epoller_->Wait(timeMS);
+        int eventCnt = reactor->epoller->Wait(timeMS);
         for (int i = 0; i < eventCnt; i++)
         {
-            /* 处理事件 */
-            int fd = epoller_->GetEventFd(i);
-            uint32_t events = epoller_->GetEvents(i);
-            if (fd == listenFd_)
+            /* 处理事件: 监听socket的data.ptr为空, 其余指向连接槽 */
+            HttpConn *client = static_cast<HttpConn *>(reactor->epoller->GetEventPtr(i));
+            uint32_t events = reactor->epoller->GetEvents(i);
+            if (client == nullptr)
             {
-                DealListen_();
+                DealListen_(reactor);
             }
             else if (events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
             {
-                assert(users_.count(fd) > 0);
-                CloseConn_(&users_[fd]);
+                CloseConn_(reactor, client);
             }
             else if (events & EPOLLIN)
             {
-                assert(users_.count(fd) > 0);
-                DealRead_(&users_[fd]);
+                DealRead_(reactor, client);
             }
             else if (events & EPOLLOUT)
             {
-                assert(users_.count(fd) > 0);
-                DealWrite_(&users_[fd]);
+                DealWrite_(reactor, client);
             }
             else
             {
@@ -140,72 +303,122 @@ void WebServer::SendError_(int fd, const char *info)
     close(fd);
 }
 
-void WebServer::CloseConn_(HttpConn *client)
+void WebServer::CloseConn_(Reactor *reactor, HttpConn *client)
 {
     assert(client);
     LOG_INFO("Client[%d] quit!", client->GetFd());
-    epoller_->DelFd(client->GetFd());
+    if (reactor->uring)
+    {
+        UringSlot &slot = reactor->slots[client->GetFd()];
+        if (client->IsClosed())
+        {
+            return;
+        }
+        if (slot.busy)
+        {
+            /* 线程池仍持有该连接, 槽位不能复用, 等其返回后再关闭 */
+            slot.closePending = true;
+            return;
+        }
+        /* 先取消该fd上未完成的recv/writev再关闭, 迟到的完成事件凭代数丢弃 */
+        slot.gen++;
+        slot.held.clear();
+        /* io_uring 模式下关闭只发生在Reactor线程, 可直接摘除定时器 */
+        reactor->timer->cancel(client->GetFd());
+        reactor->uring->PrepCancelFd(client->GetFd(), UringData_(reactor, client->GetFd(), URING_CANCEL));
+        reactor->uring->Submit();
+    }
+    else
+    {
+        reactor->epoller->DelFd(client->GetFd());
+    }
     client->Close();
 }
 
-void WebServer::AddClient_(int fd, sockaddr_in addr)
+void WebServer::AddClient_(Reactor *reactor, int fd, sockaddr_in addr)
 {
     assert(fd > 0);
-    users_[fd].init(fd, addr);
+    HttpConn *client = GetConn_(fd);
+    client->init(fd, addr);
+    owners_[fd].store(reactor, std::memory_order_relaxed);
     if (timeoutMS_ > 0)
     {
-        timer_->add(fd, timeoutMS_, std::bind(&WebServer::CloseConn_, this, &users_[fd]));
+        reactor->timer->add(fd, timeoutMS_);
+    }
+    if (reactor->uring)
+    {
+        reactor->uring->PrepRecv(fd, UringData_(reactor, fd, URING_RECV));
     }
-    epoller_->AddFd(fd, EPOLLIN | connEvent_);
-    SetFdNonblock(fd);
-    LOG_INFO("Client[%d] in!", users_[fd].GetFd());
+    else
+    {
+        reactor->epoller->AddFd(fd, EPOLLIN | connEvent_, client);
+        SetFdNonblock(fd);
+    }
+    LOG_INFO("Client[%d] in!", client->GetFd());
 }
 
-void WebServer::DealListen_()
+void WebServer::DealListen_(Reactor *reactor)
 {
     struct sockaddr_in addr;
     socklen_t len = sizeof(addr);
     do
     {
-        int fd = accept(listenFd_, (struct sockaddr *)&addr, &len);
+        int fd = accept(reactor->listenFd, (struct sockaddr *)&addr, &len);
         if (fd <= 0)
         {
             return;
         }
-        else if (HttpConn::userCount >= MAX_FD)
+        else if (HttpConn::userCount >= MAX_FD || fd >= MAX_FD)
         {
             SendError_(fd, "Server busy!");
             LOG_WARN("Clients is full!");
             return;
         }
-        AddClient_(fd, addr);
+        AddClient_(reactor, fd, addr);
     } while (listenEvent_ & EPOLLET);
 }
 
-void WebServer::DealRead_(HttpConn *client)
+void WebServer::DealRead_(Reactor *reactor, HttpConn *client)
 {
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnRead_, this, client));
+    ExtentTime_(reactor, client);
+    if (!inlineMode_)
+    {
+        threadpool_->AddTask([this, reactor, client]
+                              { OnRead_(reactor, client); });
+    }
+    else
+    {
+        /* inline模式: 在Reactor线程内读取与解析, 省去线程池切换 */
+        OnRead_(reactor, client);
+    }
 }
 
-void WebServer::DealWrite_(HttpConn *client)
+void WebServer::DealWrite_(Reactor *reactor, HttpConn *client)
 {
     assert(client);
-    ExtentTime_(client);
-    threadpool_->AddTask(std::bind(&WebServer::OnWrite_, this, client));
+    ExtentTime_(reactor, client);
+    if (!inlineMode_)
+    {
+        threadpool_->AddTask([this, reactor, client]
+                              { OnWrite_(reactor, client); });
+    }
+    else
+    {
+        OnWrite_(reactor, client);
+    }
 }
 
-void WebServer::ExtentTime_(HttpConn *client)
+void WebServer::ExtentTime_(Reactor *reactor, HttpConn *client)
 {
     assert(client);
     if (timeoutMS_ > 0)
     {
-        timer_->adjust(client->GetFd(), timeoutMS_);
+        reactor->timer->adjust(client->GetFd(), timeoutMS_);
     }
 }
 
-void WebServer::OnRead_(HttpConn *client)
+void WebServer::OnRead_(Reactor *reactor, HttpConn *client)
 {
     assert(client);
     int ret = -1;
@@ -213,25 +426,83 @@ void WebServer::OnRead_(HttpConn *client)
     ret = client->read(&readErrno);
     if (ret <= 0 && readErrno != EAGAIN)
     {
-        CloseConn_(client);
+        CloseConn_(reactor, client);
         return;
     }
-    OnProcess(client);
+    OnProcess(reactor, client);
 }
 
-void WebServer::OnProcess(HttpConn *client)
+void WebServer::OnProcess(Reactor *reactor, HttpConn *client)
 {
-    if (client->process())
+    if (!client->parse())
     {
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
+        reactor->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLIN, client);
+        return;
     }
-    else
+    if (client->NeedDb())
+    {
+        /* 数据库请求进入独立通道, 不占用静态请求的线程 */
+        dbpool_->AddTask([this, reactor, client]
+                         { OnRespond_(reactor, client); });
+        return;
+    }
+    if (inlineMode_ && client->IsBlocking())
+    {
+        /* 未缓存的文件交给线程池打开与读入, 不阻塞Reactor */
+        threadpool_->AddTask([this, reactor, client]
+                              { OnRespond_(reactor, client); });
+        return;
+    }
+    OnRespond_(reactor, client);
+}
+
+void WebServer::ReportLanes_()
+{
+    Clock::time_point now = Clock::now();
+    if (std::chrono::duration_cast<MS>(now - lastReport_).count() < LANE_REPORT_MS)
+    {
+        return;
+    }
+    lastReport_ = now;
+    for (ThreadPool *lane : {threadpool_.get(), dbpool_.get()})
+    {
+        ThreadPool::Stats stats = lane->GetStats();
+        LOG_INFO("Lane[%s] depth:%zu, executed:%zu, wait avg:%.2fms max:%.2fms", lane->Name().c_str(),
+                 stats.depth, stats.executed, stats.avgWaitMs, stats.maxWaitMs);
+    }
+    BlockPool::Stats blocks = BlockPool::Instance()->GetStats();
+    LOG_INFO("Buffer blocks in use:%zuKB, cached:%zuKB, hits:%zu, misses:%zu", blocks.inUseBytes / 1024,
+             blocks.cachedBytes / 1024, blocks.hits, blocks.misses);
+    StaticCache::Stats cache = StaticCache::Instance()->GetStats();
+    LOG_INFO("Static cache entries:%zu, size:%zuKB, hits:%zu, misses:%zu, evictions:%zu, invalidations:%zu",
+             cache.entries, cache.bytes / 1024, cache.hits, cache.misses, cache.evictions, cache.invalidations);
+    LOG_INFO("Open file cache entries:%zu, hits:%zu, misses:%zu, compressed entries:%zu, compressions:%zu",
+             cache.files, cache.fileHits, cache.fileMisses, cache.encoded, cache.compressed);
+}
+
+void WebServer::OnRespond_(Reactor *reactor, HttpConn *client)
+{
+    RespondPipelined_(client, inlineMode_);
+    /* socket发送缓冲区通常为空, 直接尝试写出, 仅在写不完时才注册EPOLLOUT */
+    OnWrite_(reactor, client);
+}
+
+void WebServer::RespondPipelined_(HttpConn *client, bool onReactor)
+{
+    /* 流水线: 读缓冲区中已完整的后续请求在当前线程依次处理, 响应按序排队后一次writev发出
+       需要换执行通道的请求(数据库/在Reactor上可能阻塞)留在缓冲区, 待本批发完后按常规路径分派 */
+    client->respond();
+    while (client->IsKeepAlive() && client->parse())
     {
-        epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLIN);
+        if (client->NeedDb() || (onReactor && client->IsBlocking()))
+        {
+            break;
+        }
+        client->respond();
     }
 }
 
-void WebServer::OnWrite_(HttpConn *client)
+void WebServer::OnWrite_(Reactor *reactor, HttpConn *client)
 {
     assert(client);
     int ret = -1;
@@ -242,24 +513,234 @@ void WebServer::OnWrite_(HttpConn *client)
         /* 传输完成 */
         if (client->IsKeepAlive())
         {
-            OnProcess(client);
+            OnProcess(reactor, client);
             return;
         }
     }
-    else if (ret < 0)
+    else if (ret > 0 || writeErrno == EAGAIN)
     {
-        if (writeErrno == EAGAIN)
+        /* 发送缓冲区已满或只写出一部分, 等待EPOLLOUT继续传输 */
+        reactor->epoller->ModFd(client->GetFd(), connEvent_ | EPOLLOUT, client);
+        return;
+    }
+    CloseConn_(reactor, client);
+}
+
+void WebServer::LoopUring_(Reactor *reactor)
+{
+    IoUring *uring = reactor->uring.get();
+    uring->PrepRead(reactor->wakeFd, &reactor->wakeBuf, sizeof(reactor->wakeBuf), URING_WAKE);
+    int timeMS = -1;
+    while (!isClose_)
+    {
+        if (reactor == reactors_[0].get())
         {
-            /* 继续传输 */
-            epoller_->ModFd(client->GetFd(), connEvent_ | EPOLLOUT);
-            return;
+            ReportLanes_();
+        }
+        if (timeoutMS_ > 0)
+        {
+            timeMS = reactor->timer->GetNextTick();
+        }
+        /* 一次系统调用提交本轮积累的全部SQE, 并收割完成事件 */
+        int eventCnt = uring->Wait(timeMS);
+        for (int i = 0; i < eventCnt; i++)
+        {
+            uint64_t data = uring->GetData(i);
+            int res = uring->GetRes(i);
+            uint32_t flags = uring->GetFlags(i);
+            int fd = static_cast<int>(data >> 32);
+            uint32_t gen = (data >> 8) & 0xffffff;
+            int op = data & 0xff;
+            if (op == URING_ACCEPT)
+            {
+                DealAcceptUring_(reactor, res, flags);
+                continue;
+            }
+            if (op == URING_WAKE)
+            {
+                DealWakeUring_(reactor);
+                continue;
+            }
+            if (op != URING_RECV && op != URING_WRITE)
+            {
+                continue;
+            }
+            /* 只凭本Reactor的代数判断: 关闭时代数已递增, fd 此后即使被其他Reactor复用,
+               迟到的完成事件也不会读写该连接 */
+            HttpConn *client = &users_[fd];
+            UringSlot &slot = reactor->slots[fd];
+            bool stale = (slot.gen & 0xffffff) != gen;
+            if (op == URING_RECV)
+            {
+                if (flags & IORING_CQE_F_BUFFER)
+                {
+                    uint16_t bid = flags >> IORING_CQE_BUFFER_SHIFT;
+                    if (!stale && res > 0)
+                    {
+                        if (slot.busy)
+                        {
+                            slot.held.append(uring->GetBuf(bid), res);
+                        }
+                        else
+                        {
+                            client->AppendRead(uring->GetBuf(bid), res);
+                        }
+                    }
+                    uring->RecycleBuf(bid);
+                }
+                if (!stale)
+                {
+                    DealRecvUring_(reactor, client, res, flags);
+                }
+            }
+            else if (!stale)
+            {
+                DealWriteUring_(reactor, client, res);
+            }
         }
     }
-    CloseConn_(client);
+}
+
+void WebServer::DealAcceptUring_(Reactor *reactor, int fd, uint32_t flags)
+{
+    if (!(flags & IORING_CQE_F_MORE))
+    {
+        /* multishot accept 已终止, 重新提交 */
+        reactor->uring->PrepAccept(reactor->listenFd, UringData_(reactor, reactor->listenFd, URING_ACCEPT));
+    }
+    if (fd < 0)
+    {
+        return;
+    }
+    if (HttpConn::userCount >= MAX_FD || fd >= MAX_FD)
+    {
+        SendError_(fd, "Server busy!");
+        LOG_WARN("Clients is full!");
+        return;
+    }
+    struct sockaddr_in addr = {0};
+    socklen_t len = sizeof(addr);
+    getpeername(fd, (struct sockaddr *)&addr, &len);
+    AddClient_(reactor, fd, addr);
+}
+
+void WebServer::DealRecvUring_(Reactor *reactor, HttpConn *client, int res, uint32_t flags)
+{
+    if (res <= 0 && res != -ENOBUFS)
+    {
+        CloseConn_(reactor, client);
+        return;
+    }
+    if (!(flags & IORING_CQE_F_MORE))
+    {
+        /* 缓冲区耗尽等原因导致multishot recv终止, 重新提交 */
+        reactor->uring->PrepRecv(client->GetFd(), UringData_(reactor, client->GetFd(), URING_RECV));
+    }
+    if (res > 0)
+    {
+        ExtentTime_(reactor, client);
+        if (client->ToWriteBytes() == 0 && !reactor->slots[client->GetFd()].busy)
+        {
+            /* 正在发送时只缓存数据, 发送完成后再处理 */
+            OnProcessUring_(reactor, client);
+        }
+    }
+}
+
+void WebServer::DealWriteUring_(Reactor *reactor, HttpConn *client, int res)
+{
+    if (res < 0)
+    {
+        CloseConn_(reactor, client);
+        return;
+    }
+    client->HasWritten(res);
+    if (client->ToWriteBytes() > 0)
+    {
+        /* 继续传输 */
+        reactor->uring->PrepWritev(client->GetFd(), client->GetIov(), client->GetIovCnt(),
+                                   UringData_(reactor, client->GetFd(), URING_WRITE));
+        return;
+    }
+    if (client->IsKeepAlive())
+    {
+        ExtentTime_(reactor, client);
+        OnProcessUring_(reactor, client);
+        return;
+    }
+    CloseConn_(reactor, client);
+}
+
+void WebServer::OnProcessUring_(Reactor *reactor, HttpConn *client)
+{
+    if (!client->parse())
+    {
+        return;
+    }
+    if (client->IsBlocking())
+    {
+        /* 交给线程池; 期间槽位标记为busy, 完成后经eventfd通知本线程 */
+        reactor->slots[client->GetFd()].busy = true;
+        ThreadPool *lane = client->NeedDb() ? dbpool_.get() : threadpool_.get();
+        lane->AddTask([this, reactor, client]
+                      { OnRespondUring_(reactor, client); });
+        return;
+    }
+    RespondPipelined_(client, true);
+    reactor->uring->PrepWritev(client->GetFd(), client->GetIov(), client->GetIovCnt(),
+                               UringData_(reactor, client->GetFd(), URING_WRITE));
+}
+
+void WebServer::OnRespondUring_(Reactor *reactor, HttpConn *client)
+{
+    /* 线程池中执行, 不能直接操作io_uring */
+    RespondPipelined_(client, false);
+    {
+        std::lock_guard<std::mutex> locker(reactor->doneMtx);
+        reactor->done.push_back(client);
+    }
+    uint64_t one = 1;
+    ssize_t ret = write(reactor->wakeFd, &one, sizeof(one));
+    assert(ret == sizeof(one));
+    (void)ret;
+}
+
+void WebServer::DealWakeUring_(Reactor *reactor)
+{
+    reactor->uring->PrepRead(reactor->wakeFd, &reactor->wakeBuf, sizeof(reactor->wakeBuf), URING_WAKE);
+    std::vector<HttpConn *> done;
+    {
+        std::lock_guard<std::mutex> locker(reactor->doneMtx);
+        done.swap(reactor->done);
+    }
+    for (HttpConn *client : done)
+    {
+        UringSlot &slot = reactor->slots[client->GetFd()];
+        slot.busy = false;
+        if (!slot.held.empty())
+        {
+            client->AppendRead(slot.held.data(), slot.held.size());
+            slot.held.clear();
+        }
+        if (slot.closePending)
+        {
+            slot.closePending = false;
+            CloseConn_(reactor, client);
+            continue;
+        }
+        reactor->uring->PrepWritev(client->GetFd(), client->GetIov(), client->GetIovCnt(),
+                                   UringData_(reactor, client->GetFd(), URING_WRITE));
+    }
+}
+
+uint64_t WebServer::UringData_(Reactor *reactor, int fd, URING_OP op)
+{
+    uint32_t gen = reactor->slots && fd >= 0 && fd < MAX_FD ? reactor->slots[fd].gen : 0;
+    return ((uint64_t)fd << 32) | ((uint64_t)(gen & 0xffffff) << 8) | op;
 }
 
 /* Create listenFd */
-bool WebServer::InitSocket_()
+bool WebServer::InitSocket_(Reactor *reactor)
 {
     int ret;
     struct sockaddr_in addr;
@@ -279,17 +760,17 @@ bool WebServer::InitSocket_()
         optLinger.l_linger = 1;
     }
 
-    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (listenFd_ < 0)
+    reactor->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (reactor->listenFd < 0)
     {
         LOG_ERROR("Create socket error!", port_);
         return false;
     }
 
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
+    ret = setsockopt(reactor->listenFd, SOL_SOCKET, SO_LINGER, &optLinger, sizeof(optLinger));
     if (ret < 0)
     {
-        close(listenFd_);
+        close(reactor->listenFd);
         LOG_ERROR("Init linger error!", port_);
         return false;
     }
@@ -297,37 +778,58 @@ bool WebServer::InitSocket_()
     int optval = 1;
     /* 端口复用 */
     /* 只有最后一个套接字会正常接收数据。 */
-    ret = setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, (const void *)&optval, sizeof(int));
+    ret = setsockopt(reactor->listenFd, SOL_SOCKET, SO_REUSEADDR, (const void *)&optval, sizeof(int));
     if (ret == -1)
     {
         LOG_ERROR("set socket setsockopt error !");
-        close(listenFd_);
+        close(reactor->listenFd);
         return false;
     }
 
-    ret = bind(listenFd_, (struct sockaddr *)&addr, sizeof(addr));
+    if (reusePort_)
+    {
+        /* 多个监听socket绑定同一端口, 由内核在各Reactor间分发新连接 */
+        ret = setsockopt(reactor->listenFd, SOL_SOCKET, SO_REUSEPORT, (const void *)&optval, sizeof(int));
+        if (ret == -1)
+        {
+            LOG_ERROR("set socket SO_REUSEPORT error !");
+            close(reactor->listenFd);
+            return false;
+        }
+    }
+
+    ret = bind(reactor->listenFd, (struct sockaddr *)&addr, sizeof(addr));
     if (ret < 0)
     {
         LOG_ERROR("Bind Port:%d error!", port_);
-        close(listenFd_);
+        close(reactor->listenFd);
         return false;
     }
 
-    ret = listen(listenFd_, 6);
+    ret = listen(reactor->listenFd, 6);
     if (ret < 0)
     {
         LOG_ERROR("Listen port:%d error!", port_);
-        close(listenFd_);
+        close(reactor->listenFd);
         return false;
     }
-    ret = epoller_->AddFd(listenFd_, listenEvent_ | EPOLLIN);
+    if (reactor->uring)
+    {
+        /* io_uring后端: 监听socket由multishot accept接管 */
+        reactor->uring->PrepAccept(reactor->listenFd, UringData_(reactor, reactor->listenFd, URING_ACCEPT));
+        ret = 1;
+    }
+    else
+    {
+        ret = reactor->epoller->AddFd(reactor->listenFd, listenEvent_ | EPOLLIN, nullptr);
+    }
     if (ret == 0)
     {
         LOG_ERROR("Add listen error!");
-        close(listenFd_);
+        close(reactor->listenFd);
         return false;
     }
-    SetFdNonblock(listenFd_);
+    SetFdNonblock(reactor->listenFd);
     LOG_INFO("Server port:%d", port_);
     return true;
 }
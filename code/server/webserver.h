@@ -6,18 +6,25 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
-#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <string>
 #include <fcntl.h>  // fcntl()
 #include <unistd.h> // close()
 #include <assert.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/stat.h> // mkdir()
+#include <sys/eventfd.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 #include "epoller.h"
+#include "uring.h"
 #include "../log/log.h"
-#include "../timer/heaptimer.h"
+#include "../timer/timewheel.h"
 #include "../pool/sqlconnpool.h"
 #include "../pool/threadpool.h"
 #include "../pool/sqlconnRAII.h"
@@ -30,29 +37,88 @@ public:
         int port, int trigMode, int timeoutMS, bool OptLinger,
         int sqlPort, const char *sqlUser, const char *sqlPwd,
         const char *dbName, int connPoolNum, int threadNum,
-        bool openLog, int logLevel, int logQueSize);
+        bool openLog, int logLevel, int logQueSize,
+        int reactorNum = 0, int ioBackend = 0, bool inlineMode = false,
+        int keepAliveMax = 100, int dbThreadNum = 4,
+        size_t maxBodySize = 8 * 1024 * 1024, size_t staticCacheSize = 32 * 1024 * 1024,
+        size_t sendfileThreshold = 1024 * 1024);
 
     ~WebServer();
     void Start();
 
 private:
-    bool InitSocket_();
+    /* io_uring后端的槽位状态, 每个Reactor各有一份, 只由该Reactor线程访问
+       fd关闭后可能被其他Reactor复用, 本Reactor上迟到的完成事件凭本地代数丢弃, 不触及连接对象 */
+    struct UringSlot
+    {
+        uint32_t gen = 0;          /* 连接代数: 关闭时递增, 用于丢弃旧连接的完成事件 */
+        bool busy = false;         /* 请求正在线程池中处理 */
+        bool closePending = false; /* 处理期间需关闭, 待线程池返回后执行 */
+        std::string held;          /* 处理期间收到的数据, 返回后再交给连接 */
+    };
+
+    /* 每个Reactor独占一个事件循环: 监听socket、Epoller(或IoUring)与定时器
+       连接槽按fd索引, fd在进程内唯一, 各Reactor互不重叠 */
+    struct Reactor
+    {
+        int listenFd = -1;
+        std::unique_ptr<Epoller> epoller;
+        std::unique_ptr<IoUring> uring; /* 非空时该Reactor使用io_uring后端 */
+        std::unique_ptr<TimeWheel> timer;
+
+        /* io_uring后端: 线程池处理完阻塞请求后经 eventfd 交还给Reactor线程提交写 */
+        std::unique_ptr<UringSlot[]> slots; /* 按fd索引, 共MAX_FD个 */
+        int wakeFd = -1;
+        uint64_t wakeBuf = 0;
+        std::mutex doneMtx;
+        std::vector<HttpConn *> done;
+    };
+
+    /* io_uring user_data: fd(32位) | 连接代数(24位) | 操作类型(8位) */
+    enum URING_OP
+    {
+        URING_ACCEPT = 1,
+        URING_RECV,
+        URING_WRITE,
+        URING_CANCEL,
+        URING_WAKE,
+    };
+
+    bool InitSocket_(Reactor *reactor);
     void InitEventMode_(int trigMode);
-    void AddClient_(int fd, sockaddr_in addr);
+    void AddClient_(Reactor *reactor, int fd, sockaddr_in addr);
+    HttpConn *GetConn_(int fd);
+    void CloseAllConn_();
 
-    void DealListen_();
-    void DealWrite_(HttpConn *client);
-    void DealRead_(HttpConn *client);
+    void Loop_(Reactor *reactor);
+    void DealListen_(Reactor *reactor);
+    void DealWrite_(Reactor *reactor, HttpConn *client);
+    void DealRead_(Reactor *reactor, HttpConn *client);
 
     void SendError_(int fd, const char *info);
-    void ExtentTime_(HttpConn *client);
-    void CloseConn_(HttpConn *client);
+    void ExtentTime_(Reactor *reactor, HttpConn *client);
+    void CloseConn_(Reactor *reactor, HttpConn *client);
+
+    void OnRead_(Reactor *reactor, HttpConn *client);
+    void OnWrite_(Reactor *reactor, HttpConn *client);
+    void OnProcess(Reactor *reactor, HttpConn *client);
+    void OnRespond_(Reactor *reactor, HttpConn *client);
+    void RespondPipelined_(HttpConn *client, bool onReactor);
+    void ReportLanes_();
 
-    void OnRead_(HttpConn *client);
-    void OnWrite_(HttpConn *client);
-    void OnProcess(HttpConn *client);
+    void LoopUring_(Reactor *reactor);
+    void DealAcceptUring_(Reactor *reactor, int fd, uint32_t flags);
+    void DealRecvUring_(Reactor *reactor, HttpConn *client, int res, uint32_t flags);
+    void DealWriteUring_(Reactor *reactor, HttpConn *client, int res);
+    void OnProcessUring_(Reactor *reactor, HttpConn *client);
+    void OnRespondUring_(Reactor *reactor, HttpConn *client);
+    void DealWakeUring_(Reactor *reactor);
+    static uint64_t UringData_(Reactor *reactor, int fd, URING_OP op);
 
     static const int MAX_FD = 65536;
+    static const unsigned URING_BUF_COUNT = 1024;
+    static const unsigned URING_BUF_SIZE = 4096;
+    static const int LANE_REPORT_MS = 10000; /* 执行通道与缓冲块统计的输出间隔 */
 
     static int SetFdNonblock(int fd);
 
@@ -60,16 +126,25 @@ private:
     bool openLinger_;
     int timeoutMS_; /* 毫秒MS */
     bool isClose_;
-    int listenFd_;
+    bool reusePort_;  /* 多Reactor模式: 各Reactor以SO_REUSEPORT监听同一端口 */
+    bool inlineMode_; /* 在Reactor线程内直接处理请求, 仅可能阻塞的请求交给线程池 */
     char *srcDir_;
 
     uint32_t listenEvent_;
     uint32_t connEvent_;
 
-    std::unique_ptr<HeapTimer> timer_;
+    /* 执行通道: 数据库请求走 dbpool_, 其余(静态文件、非inline模式下的读写)走 threadpool_
+       慢查询只会占满 dbpool_, 静态请求不受影响 */
     std::unique_ptr<ThreadPool> threadpool_;
-    std::unique_ptr<Epoller> epoller_;
-    std::unordered_map<int, HttpConn> users_;
+    std::unique_ptr<ThreadPool> dbpool_;
+    Clock::time_point lastReport_; /* 仅第一个Reactor线程访问 */
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+
+    /* 预分配的连接槽, 共MAX_FD个, 按fd索引; 槽位首次使用时原地构造, 之后复用
+       epoll_event.data.ptr 直接指向槽位, 槽位地址在整个生命周期内不变 */
+    HttpConn *users_;
+    std::unique_ptr<bool[]> usersInit_;
+    std::unique_ptr<std::atomic<Reactor *>[]> owners_; /* fd当前归属的Reactor, 过期定时器据此丢弃 */
 };
 
 #endif // WEBSERVER_H
\ No newline at end of file
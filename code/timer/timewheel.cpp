@@ -0,0 +1,240 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-17
+ * @copyleft Apache 2.0
+ */
+#include "timewheel.h"
+
+TimeWheel::TimeWheel(const ExpireCallBack &cb, NowFunc now) : cb_(cb), now_(now), current_(now()), count_(0)
+{
+    assert(cb_ && now_);
+    nodes_.reserve(64);
+    std::fill(buckets_, buckets_ + BUCKETS, -1);
+}
+
+int64_t TimeWheel::SteadyNow()
+{
+    return std::chrono::duration_cast<MS>(Clock::now().time_since_epoch()).count();
+}
+
+TimeWheel::TimerNode &TimeWheel::Node_(int id)
+{
+    assert(id >= 0);
+    if (static_cast<size_t>(id) >= nodes_.size())
+    {
+        nodes_.resize(std::max(static_cast<size_t>(id) + 1, nodes_.size() * 2));
+    }
+    return nodes_[id];
+}
+
+void TimeWheel::Link_(int id)
+{
+    TimerNode &node = nodes_[id];
+    assert(node.state == IDLE);
+    /* 已到期的结点挂到下一个槽位, 当前槽位本轮已处理过 */
+    int64_t expires = std::max(node.expires, current_ + 1);
+    int64_t delta = expires - current_;
+    int bucket;
+    if (delta < TVR_SIZE)
+    {
+        bucket = expires & (TVR_SIZE - 1);
+    }
+    else
+    {
+        int level = 1;
+        while (level < LEVELS - 1 && delta >= (int64_t(1) << (Shift_(level) + TVN_BITS)))
+        {
+            level++;
+        }
+        if (delta >= (int64_t(1) << (Shift_(level) + TVN_BITS)))
+        {
+            /* 超出时间轮范围, 先挂在最高层最远的槽位, 级联时再重新计算 */
+            expires = current_ + (int64_t(1) << (Shift_(level) + TVN_BITS)) - 1;
+        }
+        bucket = TVR_SIZE + (level - 1) * TVN_SIZE + ((expires >> Shift_(level)) & (TVN_SIZE - 1));
+    }
+
+    node.prev = -1;
+    node.next = buckets_[bucket];
+    if (node.next >= 0)
+    {
+        nodes_[node.next].prev = id;
+    }
+    buckets_[bucket] = id;
+    node.bucket = bucket;
+    node.state = LINKED;
+    count_++;
+}
+
+void TimeWheel::Unlink_(int id)
+{
+    TimerNode &node = nodes_[id];
+    assert(node.state == LINKED);
+    if (node.prev >= 0)
+    {
+        nodes_[node.prev].next = node.next;
+    }
+    else
+    {
+        buckets_[node.bucket] = node.next;
+    }
+    if (node.next >= 0)
+    {
+        nodes_[node.next].prev = node.prev;
+    }
+    node.prev = node.next = node.bucket = -1;
+    node.state = IDLE;
+    count_--;
+}
+
+void TimeWheel::add(int id, int timeout)
+{
+    TimerNode &node = Node_(id);
+    if (node.state == LINKED)
+    {
+        Unlink_(id);
+    }
+    node.state = IDLE;
+    node.expires = now_() + timeout;
+    Link_(id);
+}
+
+void TimeWheel::adjust(int id, int timeout)
+{
+    if (id < 0 || static_cast<size_t>(id) >= nodes_.size() || nodes_[id].state != LINKED)
+    {
+        add(id, timeout);
+        return;
+    }
+    TimerNode &node = nodes_[id];
+    int64_t expires = now_() + timeout;
+    if (expires >= node.expires)
+    {
+        /* 延后: 只记录新的到期时间, 旧槽位到期时再重新挂入 */
+        node.expires = expires;
+        return;
+    }
+    Unlink_(id);
+    node.expires = expires;
+    Link_(id);
+}
+
+void TimeWheel::cancel(int id)
+{
+    if (id < 0 || static_cast<size_t>(id) >= nodes_.size())
+    {
+        return;
+    }
+    if (nodes_[id].state == LINKED)
+    {
+        Unlink_(id);
+    }
+    /* 已收集但尚未回调的结点同样取消 */
+    nodes_[id].state = IDLE;
+}
+
+void TimeWheel::clear()
+{
+    nodes_.clear();
+    expired_.clear();
+    std::fill(buckets_, buckets_ + BUCKETS, -1);
+    count_ = 0;
+}
+
+void TimeWheel::Requeue_(int bucket)
+{
+    int id = buckets_[bucket];
+    buckets_[bucket] = -1;
+    while (id >= 0)
+    {
+        TimerNode &node = nodes_[id];
+        int next = node.next;
+        node.prev = node.next = node.bucket = -1;
+        node.state = IDLE;
+        count_--;
+        if (node.expires <= current_)
+        {
+            node.state = EXPIRED;
+            expired_.push_back(id);
+        }
+        else
+        {
+            Link_(id);
+        }
+        id = next;
+    }
+}
+
+void TimeWheel::tick()
+{
+    int64_t now = now_();
+    while (current_ < now)
+    {
+        if (count_ == 0)
+        {
+            current_ = now;
+            break;
+        }
+        current_++;
+        int index = current_ & (TVR_SIZE - 1);
+        if (index == 0)
+        {
+            /* 低层转完一圈, 逐层级联 */
+            for (int level = 1; level < LEVELS; level++)
+            {
+                int idx = (current_ >> Shift_(level)) & (TVN_SIZE - 1);
+                Requeue_(TVR_SIZE + (level - 1) * TVN_SIZE + idx);
+                if (idx != 0)
+                {
+                    break;
+                }
+            }
+        }
+        Requeue_(index);
+    }
+
+    /* 批量回调, 回调中可能 cancel 其他已到期的结点 */
+    for (size_t i = 0; i < expired_.size(); i++)
+    {
+        int id = expired_[i];
+        if (nodes_[id].state != EXPIRED)
+        {
+            continue;
+        }
+        nodes_[id].state = IDLE;
+        cb_(id);
+    }
+    expired_.clear();
+}
+
+int TimeWheel::GetNextTick()
+{
+    tick();
+    if (count_ == 0)
+    {
+        return -1;
+    }
+    int64_t res = TVR_SIZE;
+    for (int k = 1; k < TVR_SIZE; k++)
+    {
+        if (buckets_[(current_ + k) & (TVR_SIZE - 1)] >= 0)
+        {
+            res = k;
+            break;
+        }
+    }
+    for (int level = 1; level < LEVELS; level++)
+    {
+        int shift = Shift_(level);
+        int64_t base = current_ >> shift;
+        for (int d = 1; d <= TVN_SIZE; d++)
+        {
+            if (buckets_[TVR_SIZE + (level - 1) * TVN_SIZE + ((base + d) & (TVN_SIZE - 1))] >= 0)
+            {
+                res = std::min(res, ((base + d) << shift) - current_);
+                break;
+            }
+        }
+    }
+    return static_cast<int>(res);
+}
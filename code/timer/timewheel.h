@@ -0,0 +1,100 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-17
+ * @copyleft Apache 2.0
+ */
+#ifndef TIME_WHEEL_H
+#define TIME_WHEEL_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <assert.h>
+#include <stdint.h>
+#include <chrono>
+#include "../log/log.h"
+
+typedef std::function<void(int)> ExpireCallBack;
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::milliseconds MS;
+
+/* 分层时间轮, 精度1ms: 第0层256槽, 第1~3层各64槽, 覆盖约18.6小时
+   结点按id(连接fd)直接索引, add/adjust/cancel 均为O(1)
+   延长超时只改写结点的到期时间, 槽位到期时再惰性地重新挂到正确位置 */
+class TimeWheel
+{
+public:
+    /* 当前时刻(ms)的来源, 默认取 steady_clock; 测试时可换成手动推进的时钟 */
+    typedef int64_t (*NowFunc)();
+
+    explicit TimeWheel(const ExpireCallBack &cb, NowFunc now = &TimeWheel::SteadyNow);
+
+    ~TimeWheel() = default;
+
+    void add(int id, int timeout);
+
+    void adjust(int id, int timeout);
+
+    void cancel(int id);
+
+    void clear();
+
+    /* 推进时间轮, 收集本次到期的结点后统一回调 */
+    void tick();
+
+    /* 返回距下一个待处理槽位的毫秒数, 无定时器时返回-1 */
+    int GetNextTick();
+
+    static int64_t SteadyNow();
+
+private:
+    enum NODE_STATE
+    {
+        IDLE = 0,
+        LINKED,
+        EXPIRED,
+    };
+
+    struct TimerNode
+    {
+        int64_t expires = 0;
+        int prev = -1;
+        int next = -1;
+        int bucket = -1;
+        uint8_t state = IDLE;
+    };
+
+    static const int TVR_BITS = 8;
+    static const int TVN_BITS = 6;
+    static const int TVR_SIZE = 1 << TVR_BITS;
+    static const int TVN_SIZE = 1 << TVN_BITS;
+    static const int LEVELS = 4;
+    static const int BUCKETS = TVR_SIZE + TVN_SIZE * (LEVELS - 1);
+
+    static int Shift_(int level)
+    {
+        return TVR_BITS + TVN_BITS * (level - 1);
+    }
+
+    void Link_(int id);
+
+    void Unlink_(int id);
+
+    /* 摘下整个槽位: 已到期的放入 expired_, 其余按到期时间重新挂入 */
+    void Requeue_(int bucket);
+
+    TimerNode &Node_(int id);
+
+    ExpireCallBack cb_;
+    NowFunc now_;
+
+    std::vector<TimerNode> nodes_;
+    int buckets_[BUCKETS];
+
+    int64_t current_; /* 时间轮已推进到的时刻(ms) */
+    size_t count_;    /* 挂在轮上的结点数 */
+
+    std::vector<int> expired_;
+};
+
+#endif // TIME_WHEEL_H
@@ -0,0 +1,84 @@
+/*
+ * @Author       : mark
+ * @Date         : 2020-06-26
+ * @copyleft Apache 2.0
+ */
+#include "../code/http/httprequest.h"
+#include "../code/buffer/arena.h"
+#include <regex>
+#include <chrono>
+#include <cstdio>
+
+/* 原有的正则解析器, 仅作对比基准: 每行拷贝为string, 每行重新构造regex */
+struct RegexRequest {
+    std::string method, path, version, body;
+    std::unordered_map<std::string, std::string> header;
+
+    bool parse(Buffer &buff) {
+        const char CRLF[] = "\r\n";
+        int state = 0;
+        while(buff.ReadableBytes() && state != 3) {
+            const char *lineEnd = std::search(buff.Peek(), buff.BeginWriteConst(), CRLF, CRLF + 2);
+            std::string line(buff.Peek(), lineEnd);
+            std::smatch subMatch;
+            if(state == 0) {
+                std::regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
+                if(!std::regex_match(line, subMatch, patten)) { return false; }
+                method = subMatch[1]; path = subMatch[2]; version = subMatch[3];
+                state = 1;
+            }
+            else if(state == 1) {
+                std::regex patten("^([^:]*): ?(.*)$");
+                if(std::regex_match(line, subMatch, patten)) { header[subMatch[1]] = subMatch[2]; }
+                else { state = 2; }
+                if(buff.ReadableBytes() <= 2) { state = 3; }
+            }
+            else { body = line; state = 3; }
+            if(lineEnd == buff.BeginWrite()) { break; }
+            buff.RetrieveUntil(lineEnd + 2);
+        }
+        return true;
+    }
+};
+
+const char *REQUESTS[] = {
+    "GET / HTTP/1.1\r\nHost: 127.0.0.1:1316\r\nConnection: keep-alive\r\n\r\n",
+    "GET /images/instagram-image4.jpg HTTP/1.1\r\nHost: localhost:1316\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+    "Accept: image/avif,image/webp,*/*\r\nAccept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\nReferer: http://localhost:1316/picture\r\n"
+    "Connection: keep-alive\r\nSec-Fetch-Dest: image\r\nSec-Fetch-Mode: no-cors\r\n\r\n",
+};
+
+template<class F>
+double Measure(const char *req, int rounds, F parse) {
+    Buffer buff;
+    size_t len = strlen(req);
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < rounds; i++) {
+        buff.Append(req, len);
+        if(!parse(buff)) { printf("parse failed\n"); return 0; }
+        buff.RetrieveAll();
+    }
+    auto cost = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(cost).count() / (double)rounds;
+}
+
+int main() {
+    const int ROUNDS = 200000;
+    Arena arena;
+    HttpRequest request(&arena);
+    for(const char *req : REQUESTS) {
+        double regexNs = Measure(req, ROUNDS / 20, [](Buffer &buff) {
+            RegexRequest r;
+            return r.parse(buff);
+        });
+        double handNs = Measure(req, ROUNDS, [&](Buffer &buff) {
+            request.Init();
+            arena.Reset();
+            return request.parse(buff) == HttpRequest::GET_REQUEST;
+        });
+        printf("%4zu bytes: regex %9.1f ns/req, hand-written %7.1f ns/req, x%.1f\n",
+               strlen(req), regexNs, handNs, regexNs / handNs);
+    }
+}
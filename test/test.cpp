@@ -5,7 +5,15 @@
  */ 
 #include "../code/log/log.h"
 #include "../code/pool/threadpool.h"
+#include "../code/http/httprequest.h"
+#include "../code/http/httpresponse.h"
+#include "../code/buffer/arena.h"
+#include "../code/timer/timewheel.h"
+#include <assert.h>
 #include <features.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #if __GLIBC__ == 2 && __GLIBC_MINOR__ < 30
 #include <sys/syscall.h>
@@ -50,7 +58,535 @@ void TestThreadPool() {
     getchar();
 }
 
+HttpRequest::HTTP_CODE ParseRequest(const std::string &raw) {
+    Arena arena;
+    Buffer buff;
+    buff.Append(raw);
+    HttpRequest request(&arena);
+    return request.parse(buff);
+}
+
+void TestHeaderFraming() {
+    /* 重复且值不同的 Content-Length 会让前后端对请求边界的判断不一致 */
+    assert(ParseRequest("POST /login HTTP/1.1\r\nHost: a\r\nContent-Length: 0\r\n"
+                        "Content-Length: 20\r\n\r\nuser=a&password=b123") == HttpRequest::BAD_REQUEST);
+    assert(ParseRequest("POST /login HTTP/1.1\r\nHost: a\r\nContent-Length: 3\r\n"
+                        "Content-Length:  3\r\n\r\na=b") == HttpRequest::GET_REQUEST);
+    assert(ParseRequest("POST /login HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n"
+                        "Transfer-Encoding: chunked\r\n\r\n0\r\n\r\n") == HttpRequest::BAD_REQUEST);
+    assert(ParseRequest("GET / HTTP/1.1\r\nHost: a\r\nHost: b\r\n\r\n") == HttpRequest::BAD_REQUEST);
+    /* 其余常用头部仍是后者覆盖前者 */
+    assert(ParseRequest("GET / HTTP/1.1\r\nHost: a\r\nConnection: close\r\n"
+                        "Connection: keep-alive\r\n\r\n") == HttpRequest::GET_REQUEST);
+}
+
+/* 逐段追加到同一缓冲区并续解析, 模拟请求分多次到达; 返回最后一段的解析结果 */
+HttpRequest::HTTP_CODE ParseParts(HttpRequest &request, Buffer &buff, std::initializer_list<std::string> parts) {
+    HttpRequest::HTTP_CODE ret = HttpRequest::NO_REQUEST;
+    for(const std::string &part : parts) {
+        assert(ret == HttpRequest::NO_REQUEST);
+        buff.Append(part);
+        ret = request.parse(buff);
+    }
+    return ret;
+}
+
+void TestChunkedBody() {
+    /* Transfer-Encoding 与 Content-Length 同时出现时拒绝 */
+    assert(ParseRequest("POST /login HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n"
+                        "Content-Length: 5\r\n\r\n0\r\n\r\n") == HttpRequest::BAD_REQUEST);
+    assert(ParseRequest("POST /login HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: gzip, chunked\r\n"
+                        "\r\n0\r\n\r\n") == HttpRequest::BAD_REQUEST);
+
+    /* 块扩展与尾部字段校验后丢弃, 块可在任意字节处断开 */
+    {
+        Arena arena;
+        Buffer buff;
+        HttpRequest request(&arena);
+        assert(ParseParts(request, buff, {
+            "POST /login HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n",
+            "5;name=\"v\";x\r\nhel", "lo\r\n6 \r\n world\r\n0\r\nX-Trailer: 1\r\n",
+            "X-Other: 2\r\n\r\nGET / HTTP/1.1\r\n\r\n"}) == HttpRequest::GET_REQUEST);
+        assert(request.body().Data() == "hello world");
+        /* 结束块之后的流水线请求留在缓冲区 */
+        assert(std::string(buff.Peek(), buff.ReadableBytes()) == "GET / HTTP/1.1\r\n\r\n");
+    }
+
+    /* 块长度超过15位十六进制数时拒绝, 防止溢出 */
+    assert(ParseRequest("POST /login HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n"
+                        "10000000000000000\r\nx\r\n0\r\n\r\n") == HttpRequest::BAD_REQUEST);
+    assert(ParseRequest("POST /login HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n"
+                        "fffffffffffffff\r\nx\r\n0\r\n\r\n") == HttpRequest::TOO_LARGE_REQUEST);
+    /* 块长度之后缺少CRLF, 或数据段之后不是CRLF */
+    assert(ParseRequest("POST /login HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n"
+                        "3\nabc\r\n0\r\n\r\n") == HttpRequest::BAD_REQUEST);
+    assert(ParseRequest("POST /login HTTP/1.1\r\nHost: a\r\nTransfer-Encoding: chunked\r\n\r\n"
+                        "3\r\nabcd\r\n0\r\n\r\n") == HttpRequest::BAD_REQUEST);
+}
+
+void TestMultipartSplit() {
+    /* 请求体在每个位置断开分两次到达, 分隔符被截断时也应得到同样的结果; 文件内容中含分隔符的前缀 */
+    const std::string body =
+        "--XyZ\r\nContent-Disposition: form-data; name=\"user\"\r\n\r\nalice\r\n"
+        "--XyZ\r\nContent-Disposition: form-data; name=\"f\"; filename=\"a.txt\"\r\n"
+        "Content-Type: text/plain\r\n\r\nab\r\n--Xy\r\n--XyQ\r\n"
+        "--XyZ--\r\n";
+    const std::string head = "POST /upload HTTP/1.1\r\nHost: a\r\n"
+        "Content-Type: multipart/form-data; boundary=XyZ\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+    for(size_t i = 1; i < body.size(); i++) {
+        Arena arena;
+        Buffer buff;
+        HttpRequest request(&arena);
+        assert(ParseParts(request, buff, {head + body.substr(0, i), body.substr(i)}) == HttpRequest::GET_REQUEST);
+        assert(request.GetPost("user") == "alice");
+        assert(request.files().size() == 1);
+        const MultipartParser::FilePart &part = request.files()[0];
+        assert(part.name == "f" && part.filename == "a.txt" && part.contentType == "text/plain");
+        assert(request.body().Data().substr(part.offset, part.length) == "ab\r\n--Xy\r\n--XyQ");
+    }
+    /* 缺少结束分隔符时拒绝 */
+    assert(ParseRequest("POST /upload HTTP/1.1\r\nHost: a\r\nContent-Type: multipart/form-data; boundary=XyZ\r\n"
+                        "Content-Length: 14\r\n\r\n--XyZ\r\n\r\nabc\r\n") == HttpRequest::BAD_REQUEST);
+}
+
+/* 在已有一个字节的临时文件中调用 CopyTo, 读回拷入的部分; 确认写在当前位置而不是覆盖开头 */
+std::string CopyBody(const RequestBody &body, size_t offset, size_t len, int flags) {
+    char path[] = "/tmp/webserver-test-XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    unlink(path);
+    assert(fcntl(fd, F_SETFL, flags) == 0);
+    assert(write(fd, "#", 1) == 1);
+    assert(body.CopyTo(fd, offset, len));
+    std::string out(len + 1, '\0');
+    assert(pread(fd, &out[0], out.size(), 0) == (ssize_t)out.size());
+    assert(out[0] == '#');
+    char extra;
+    assert(pread(fd, &extra, 1, out.size()) == 0);
+    close(fd);
+    return out.substr(1);
+}
+
+void TestBodyCopy() {
+    std::string data(200 * 1024, '\0');
+    for(size_t i = 0; i < data.size(); i++) {
+        data[i] = static_cast<char>(i * 131 + i / 997);
+    }
+    Arena arena;
+    /* 不超过 MEMORY_LIMIT 时存于内存, 直接 write */
+    {
+        RequestBody body(&arena);
+        assert(body.Open(1000));
+        assert(body.Append(data.data(), 600) && body.Append(data.data() + 600, 400));
+        assert(body.InMemory() && body.Size() == 1000);
+        assert(CopyBody(body, 100, 800, 0) == data.substr(100, 800));
+        assert(CopyBody(body, 0, 1000, 0) == data.substr(0, 1000));
+        assert(!body.CopyTo(-1, 900, 101));
+    }
+    /* 长度未知时先存内存, 超出后转存临时文件, 以 copy_file_range 拷贝
+       目标为 O_APPEND 时内核拒绝 copy_file_range, 退回 pread/write */
+    {
+        RequestBody body(&arena);
+        assert(body.Open(0));
+        for(size_t off = 0; off < data.size(); off += 10000) {
+            assert(body.Append(data.data() + off, std::min<size_t>(10000, data.size() - off)));
+        }
+        assert(!body.InMemory() && body.Size() == data.size());
+        assert(CopyBody(body, 12345, 150000, 0) == data.substr(12345, 150000));
+        assert(CopyBody(body, 12345, 150000, O_APPEND) == data.substr(12345, 150000));
+        assert(CopyBody(body, 0, data.size(), O_APPEND) == data);
+        assert(!body.CopyTo(-1, data.size(), 1));
+    }
+}
+
+std::string ReadFile(const std::string &path) {
+    std::string out;
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return "<missing>";
+    }
+    char chunk[4096];
+    ssize_t n;
+    while((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        out.append(chunk, n);
+    }
+    close(fd);
+    return out;
+}
+
+/* 以 multipart 表单 POST 到 path, 每个文件部分为 {filename, 内容}; 返回 Upload() 之后的路径 */
+std::string PostUpload(const std::string &path, std::initializer_list<std::pair<std::string, std::string>> files) {
+    std::string body;
+    for(const auto &file : files) {
+        body += "--XyZ\r\nContent-Disposition: form-data; name=\"f\"; filename=\"" + file.first + "\"\r\n"
+                "Content-Type: application/octet-stream\r\n\r\n" + file.second + "\r\n";
+    }
+    body += "--XyZ--\r\n";
+    Arena arena;
+    Buffer buff;
+    HttpRequest request(&arena);
+    assert(ParseParts(request, buff, {"POST " + path + " HTTP/1.1\r\nHost: a\r\n"
+        "Content-Type: multipart/form-data; boundary=XyZ\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n",
+        body}) == HttpRequest::GET_REQUEST);
+    assert(request.body().InMemory() == (body.size() <= RequestBody::MEMORY_LIMIT));
+    assert(request.NeedUpload() == (path == "/upload"));
+    request.Upload();
+    assert(!request.NeedUpload());
+    return std::string(request.path());
+}
+
+void TestUpload() {
+    char dir[] = "/tmp/webserver-upload-XXXXXX";
+    assert(mkdtemp(dir));
+    const char *saved = HttpRequest::uploadDir;
+    HttpRequest::uploadDir = dir;
+    std::string big(100 * 1024, 'x');
+    for(size_t i = 0; i < big.size(); i += 7) {
+        big[i] = static_cast<char>(i);
+    }
+    /* 请求体在内存中 */
+    assert(PostUpload("/upload", {{"a.txt", "hello"}, {"b.bin", "--XyZ-\r\n"}}) == "/welcome.html");
+    assert(ReadFile(std::string(dir) + "/a.txt") == "hello");
+    assert(ReadFile(std::string(dir) + "/b.bin") == "--XyZ-\r\n");
+    /* 请求体转存到临时文件; 客户端路径只保留最后一段 */
+    assert(PostUpload("/upload", {{"../../c.bin", big}, {"C:\\\\dir\\\\d.txt", "d"}}) == "/welcome.html");
+    assert(ReadFile(std::string(dir) + "/c.bin") == big);
+    assert(ReadFile(std::string(dir) + "/d.txt") == "d");
+    /* 非法文件名不写入 */
+    assert(PostUpload("/upload", {{"..", "e"}}) == "/error.html");
+    /* 其他路径不保存文件 */
+    assert(PostUpload("/other", {{"f.txt", "f"}}) == "/other");
+    assert(ReadFile(std::string(dir) + "/f.txt") == "<missing>");
+    for(const char *name : {"a.txt", "b.bin", "c.bin", "d.txt"}) {
+        unlink((std::string(dir) + "/" + name).c_str());
+    }
+    assert(rmdir(dir) == 0);
+    HttpRequest::uploadDir = saved;
+}
+
+/* 对 srcDir 下的 path 生成条件请求的响应, 返回状态码 */
+int ConditionalCode(const char *srcDir, const char *path, const char *acceptEncoding, const std::string &ifNoneMatch) {
+    HttpResponse response;
+    Buffer buff;
+    response.Init(srcDir, path, false, 200);
+    response.SetAcceptEncoding(acceptEncoding);
+    response.SetConditional(ifNoneMatch, "");
+    response.MakeResponse(buff);
+    response.UnmapFile();
+    return response.Code();
+}
+
+void TestConditional() {
+    char dir[] = "/tmp/webtest-XXXXXX";
+    assert(mkdtemp(dir));
+    for(const char *name : {"/a.html", "/b.png"}) {
+        int fd = open((std::string(dir) + name).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        assert(fd >= 0 && write(fd, "hello", 5) == 5);
+        close(fd);
+    }
+    struct stat st;
+    assert(stat((std::string(dir) + "/a.html").c_str(), &st) == 0);
+    char buf[64];
+    std::string plain(buf, StaticCache::FormatETag(st, -1, buf, sizeof(buf)));
+    std::string gzip(buf, StaticCache::FormatETag(st, StaticCache::GZIP, buf, sizeof(buf)));
+    std::string br(buf, StaticCache::FormatETag(st, StaticCache::BROTLI, buf, sizeof(buf)));
+
+    /* 编码版本的 ETag 只在客户端接受该编码时匹配, 由此检查 Accept-Encoding 的解析 */
+    struct {
+        const char *acceptEncoding;
+        bool gzip, br;
+    } encodings[] = {
+        {"", false, false},
+        {"gzip", true, false},
+        {"GZip, BR", true, true},
+        {"gzip;q=0", false, false},
+        {"gzip; Q=0.000, br;q=0.5", false, true},
+        {"gzip;level=1;q=0", false, false},
+        {"gzip;q=0;level=1", false, false},
+        {"gzip;level=1;q=0.001", true, false},
+        {"gzip;q=0.", false, false},
+        {"br;q=1.000", false, true},
+        {"*", true, true},
+        {"*;q=0", false, false},
+        {" identity , x-gzip ,gzipx", false, false},
+    };
+    for(auto &e : encodings) {
+        assert(ConditionalCode(dir, "/a.html", e.acceptEncoding, plain) == 304);
+        assert(ConditionalCode(dir, "/a.html", e.acceptEncoding, gzip) == (e.gzip ? 304 : 200));
+        assert(ConditionalCode(dir, "/a.html", e.acceptEncoding, br) == (e.br ? 304 : 200));
+        assert(ConditionalCode(dir, "/a.html", e.acceptEncoding, "W/" + gzip) == (e.gzip ? 304 : 200));
+    }
+
+    /* If-None-Match 的列表格式: 弱比较忽略 W/, 格式错误时按未命中处理 */
+    struct {
+        std::string ifNoneMatch;
+        int code;
+    } tags[] = {
+        {plain, 304},
+        {"W/" + plain, 304},
+        {"*", 304},
+        {" * ", 304},
+        {"\"x\", " + plain, 304},
+        {",, \"x\" ,W/" + plain + ",", 304},
+        {"\"x\"", 200},
+        {"w/" + plain, 200},
+        {plain.substr(1), 200},
+        {plain.substr(0, plain.size() - 1), 200},
+        {"\"x\" " + plain, 200},
+        {"W/ " + plain, 200},
+        {gzip, 304},
+    };
+    for(auto &t : tags) {
+        assert(ConditionalCode(dir, "/a.html", "gzip", t.ifNoneMatch) == t.code);
+    }
+    /* 已是压缩格式的类型没有编码版本 */
+    assert(stat((std::string(dir) + "/b.png").c_str(), &st) == 0);
+    assert(ConditionalCode(dir, "/b.png", "gzip", std::string(buf, StaticCache::FormatETag(st, -1, buf, sizeof(buf)))) == 304);
+    assert(ConditionalCode(dir, "/b.png", "gzip", std::string(buf, StaticCache::FormatETag(st, StaticCache::GZIP, buf, sizeof(buf)))) == 200);
+
+    for(const char *name : {"/a.html", "/b.png"}) {
+        unlink((std::string(dir) + name).c_str());
+    }
+    assert(rmdir(dir) == 0);
+}
+
+/* 按 GetIov 拼出可读数据, 同时检查各段长度 */
+std::string BufferContent(const Buffer &buff, std::vector<size_t> *lens = nullptr) {
+    struct iovec iov[64];
+    int cnt = buff.GetIov(iov, 64);
+    std::string str;
+    for(int i = 0; i < cnt; i++) {
+        str.append(static_cast<char *>(iov[i].iov_base), iov[i].iov_len);
+        if(lens) {
+            lens->push_back(iov[i].iov_len);
+        }
+    }
+    assert(str.size() == buff.ReadableBytes());
+    return str;
+}
+
+size_t InUseBytes() {
+    return BlockPool::Instance()->GetStats().inUseBytes;
+}
+
+void TestBuffer() {
+    const size_t base = InUseBytes();
+    std::string data;
+    for(int i = 0; i < 200000; i++) {
+        data.push_back('a' + i % 26);
+    }
+    {
+        /* 追加跨块: 先填满尾块, 余下链接新块, 已有数据不搬移 */
+        Buffer buff(1024);
+        buff.Append(data.data(), 1000);
+        const char *first = buff.Peek();
+        buff.Append(data.data() + 1000, 100);
+        std::vector<size_t> lens;
+        assert(BufferContent(buff, &lens) == data.substr(0, 1100));
+        assert(lens == std::vector<size_t>({1024, 76}));
+        buff.Append(data.data() + 1100, 5000);
+        lens.clear();
+        assert(BufferContent(buff, &lens) == data.substr(0, 6100));
+        assert(lens == std::vector<size_t>({1024, 1024, 4052}));
+        struct iovec iov[2];
+        assert(buff.GetIov(iov, 2) == 2 && iov[0].iov_base == first);
+        assert(InUseBytes() == base + 1024 + 1024 + 4096);
+
+        /* 部分取走跨越块边界: 取完的块立即归还 */
+        buff.Retrieve(1030);
+        lens.clear();
+        assert(BufferContent(buff, &lens) == data.substr(1030, 5070));
+        assert(lens == std::vector<size_t>({1018, 4052}));
+        assert(buff.PrependableBytes() == 6);
+        assert(InUseBytes() == base + 1024 + 4096);
+
+        /* 拆分后 Peek 合并为连续的一块 */
+        assert(std::string(buff.Peek(), buff.ReadableBytes()) == data.substr(1030, 5070));
+        lens.clear();
+        assert(BufferContent(buff, &lens) == data.substr(1030, 5070));
+        assert(lens.size() == 1);
+        assert(buff.BeginWriteConst() == buff.Peek() + buff.ReadableBytes());
+        buff.RetrieveUntil(buff.Peek() + 70);
+        assert(BufferContent(buff) == data.substr(1100, 5000));
+
+        /* 取完即全部归还内存池 */
+        buff.Retrieve(5000);
+        assert(buff.ReadableBytes() == 0 && InUseBytes() == base);
+        assert(buff.RetrieveAllToStr().empty());
+    }
+    {
+        /* ReadFd: 读入量小时拷贝到合适大小的块, 大时直接链接借来的最大级别块 */
+        int fds[2];
+        assert(pipe(fds) == 0);
+        Buffer buff(1024);
+        int err = 0;
+        buff.Append(data.data(), 1000);
+        assert(write(fds[1], data.data() + 1000, 2000) == 2000);
+        assert(buff.ReadFd(fds[0], &err) == 2000);
+        std::vector<size_t> lens;
+        assert(BufferContent(buff, &lens) == data.substr(0, 3000));
+        assert(lens == std::vector<size_t>({1024, 1976}));
+        assert(InUseBytes() == base + 1024 + 4096);
+
+        const size_t big = BlockPool::MAX_CLASS / 2 + 100;
+        assert(write(fds[1], data.data() + 3000, big) == (ssize_t)big);
+        assert(buff.ReadFd(fds[0], &err) == (ssize_t)big);
+        lens.clear();
+        assert(BufferContent(buff, &lens) == data.substr(0, 3000 + big));
+        assert(lens == std::vector<size_t>({1024, 4096, big - 2120}));
+        assert(InUseBytes() == base + 1024 + 4096 + BlockPool::MAX_CLASS);
+
+        /* WriteFd 发出后块全部归还, 再次分配由空闲链表满足 */
+        std::string out;
+        while(buff.ReadableBytes() > 0) {
+            ssize_t len = buff.WriteFd(fds[1], &err);
+            assert(len > 0);
+            while(len > 0) {
+                char tmp[4096];
+                ssize_t n = read(fds[0], tmp, std::min(sizeof(tmp), (size_t)len));
+                assert(n > 0);
+                out.append(tmp, n);
+                len -= n;
+            }
+        }
+        assert(out == data.substr(0, 3000 + big));
+        assert(InUseBytes() == base);
+        const size_t hits = BlockPool::Instance()->GetStats().hits;
+        buff.Append(data.data(), 10);
+        assert(BlockPool::Instance()->GetStats().hits == hits + 1);
+        close(fds[0]);
+        close(fds[1]);
+    }
+    assert(InUseBytes() == base);
+}
+
+/* 时间轮测试用的手动时钟 */
+static int64_t wheelNow;
+
+int64_t WheelNow() {
+    return wheelNow;
+}
+
+struct Fired {
+    int id;
+    int64_t at;
+};
+
+/* step 为0时按 GetNextTick 跳到下一个待处理槽位, 直到没有定时器; 否则每次推进 step 毫秒直到 until */
+void RunWheel(TimeWheel &wheel, int step, int64_t until) {
+    if(step > 0) {
+        while(wheelNow < until) {
+            wheelNow += step;
+            wheel.tick();
+        }
+        return;
+    }
+    for(int next = wheel.GetNextTick(); next >= 0; next = wheel.GetNextTick()) {
+        assert(next > 0);
+        wheelNow += next;
+        wheel.tick();
+    }
+}
+
+void TestTimeWheel() {
+    const int64_t LV1 = 256, LV2 = 256 * 64, LV3 = 256 * 64 * 64, RANGE = 256 * 64 * 64 * 64;
+    /* 逐毫秒推进与按 GetNextTick 跳跃推进, 结果都须与到期时间一致 */
+    for(int step : {1, 0}) {
+        /* 起点不对齐槽位, 到期时间跨越各层边界 */
+        wheelNow = 1000003;
+        const int64_t start = wheelNow;
+        std::vector<Fired> fired;
+        TimeWheel *self = nullptr;
+        TimeWheel wheel([&](int id) {
+            fired.push_back({id, wheelNow});
+            if(id == 20 || id == 21) {
+                /* 回调中取消同一批到期的另一个结点 */
+                self->cancel(41 - id);
+            }
+        }, WheelNow);
+        self = &wheel;
+        assert(wheel.GetNextTick() == -1);
+
+        std::vector<std::pair<int, int64_t>> timers = {
+            {1, 1}, {2, LV1 - 1}, {3, LV1}, {4, LV1 + 1},
+            {5, LV2 - 1}, {6, LV2}, {7, LV2 + 1},
+            {8, LV3 - 1}, {9, LV3}, {10, LV3 + 1},
+        };
+        if(step == 0) {
+            /* 超出时间轮范围的先挂在最远处, 级联时再重新计算 */
+            timers.push_back({11, RANGE + 5});
+        }
+        for(auto &t : timers) {
+            wheel.add(t.first, t.second);
+        }
+        /* 重复 add 同一个id: 只保留最后一次 */
+        wheel.add(12, 100);
+        wheel.add(12, LV1 + 3);
+        timers.push_back({12, LV1 + 3});
+        /* adjust 延后只改到期时间, 旧槽位到期后重新挂入; 提前则立即移动 */
+        wheel.add(13, 50);
+        wheel.adjust(13, LV2 + 7);
+        timers.push_back({13, LV2 + 7});
+        wheel.add(14, LV2);
+        wheel.adjust(14, 30);
+        timers.push_back({14, 30});
+        /* 取消的不回调 */
+        wheel.add(15, 40);
+        wheel.cancel(15);
+        wheel.add(16, LV2 + 2);
+        wheel.cancel(16);
+        /* 同时到期的两个结点, 先回调的取消另一个, 只回调一次(记为20) */
+        wheel.add(20, 77);
+        wheel.add(21, 77);
+        timers.push_back({20, 77});
+
+        /* 中途重新 add 已到期的id */
+        wheelNow += 10;
+        wheel.tick();
+        assert(fired.size() == 1 && fired[0].id == 1 && fired[0].at == start + 10);
+        wheel.add(1, 500);
+        timers[0].second = 10 + 500;
+
+        RunWheel(wheel, step, start + LV3 + 2);
+        std::sort(timers.begin(), timers.end(), [](const std::pair<int, int64_t> &a,
+                                                   const std::pair<int, int64_t> &b) {
+            return a.second < b.second;
+        });
+        /* 第一次回调(id 1)在重新 add 之前 */
+        assert(fired.size() == timers.size() + 1);
+        for(size_t i = 0; i < timers.size(); i++) {
+            const Fired &f = fired[i + 1];
+            assert((f.id == 21 ? 20 : f.id) == timers[i].first);
+            assert(f.at == start + timers[i].second);
+        }
+        assert(wheel.GetNextTick() == -1);
+    }
+
+    /* GetNextTick 不超过最近的到期时间; clear 后为空 */
+    wheelNow = 5;
+    int count = 0;
+    TimeWheel wheel([&](int) { count++; }, WheelNow);
+    wheel.add(3, LV2 + 9);
+    int next = wheel.GetNextTick();
+    assert(next > 0 && next <= LV2 + 9);
+    wheel.add(4, 20);
+    assert(wheel.GetNextTick() == 20);
+    wheel.clear();
+    assert(wheel.GetNextTick() == -1);
+    wheelNow += LV2 * 2;
+    wheel.tick();
+    assert(count == 0);
+}
+
 int main() {
+    TestHeaderFraming();
+    TestChunkedBody();
+    TestMultipartSplit();
+    TestBodyCopy();
+    TestUpload();
+    TestConditional();
+    TestTimeWheel();
+    TestBuffer();
     TestLog();
     TestThreadPool();
 }
\ No newline at end of file